@@ -19,6 +19,8 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+    unsigned long long cache_hit_cnt;   /* Sector lookups found in cache. */
+    unsigned long long cache_miss_cnt;  /* Sector lookups not in cache. */
   };
 
 /* List of all block devices. */
@@ -160,6 +162,18 @@ block_type (struct block *block)
   return block->type;
 }
 
+/* Records a lookup of one of BLOCK's sectors in a cache layered
+   above it, which found the sector already cached if HIT is
+   true. */
+void
+block_count_cache_access (struct block *block, bool hit)
+{
+  if (hit)
+    block->cache_hit_cnt++;
+  else
+    block->cache_miss_cnt++;
+}
+
 /* Prints statistics for each block device used for a Pintos role. */
 void
 block_print_stats (void)
@@ -171,9 +185,13 @@ block_print_stats (void)
       struct block *block = block_by_role[i];
       if (block != NULL)
         {
-          printf ("%s (%s): %llu reads, %llu writes\n",
+          printf ("%s (%s): %llu reads, %llu writes",
                   block->name, block_type_name (block->type),
                   block->read_cnt, block->write_cnt);
+          if (block->cache_hit_cnt != 0 || block->cache_miss_cnt != 0)
+            printf (", %llu cache hits, %llu cache misses",
+                    block->cache_hit_cnt, block->cache_miss_cnt);
+          printf ("\n");
         }
     }
 }
@@ -200,6 +218,8 @@ block_register (const char *name, enum block_type type,
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  block->cache_hit_cnt = 0;
+  block->cache_miss_cnt = 0;
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -1,6 +1,7 @@
 #ifndef DEVICES_BLOCK_H
 #define DEVICES_BLOCK_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <inttypes.h>
 
@@ -57,6 +58,7 @@ const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
 /* Statistics. */
+void block_count_cache_access (struct block *, bool hit);
 void block_print_stats (void);
 
 /* Lower-level interface to block device drivers. */
@@ -11,9 +11,6 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -81,3 +78,69 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Configures CHANNEL in mode 0, "interrupt on terminal count":
+   its output goes high once, COUNT PIT cycles from now, and
+   stays high until the channel is reprogrammed.  On channel 0
+   this raises a single timer interrupt.  After reaching zero,
+   the counter wraps around to 65535 and keeps counting down.
+   COUNT must be nonzero. */
+void
+pit_start_oneshot (int channel, uint16_t count)
+{
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+  ASSERT (count != 0);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30);
+  outb (PIT_PORT_COUNTER (channel), count);
+  outb (PIT_PORT_COUNTER (channel), count >> 8);
+  intr_set_level (old_level);
+}
+
+/* Returns the current value of CHANNEL's counter, which counts
+   down by one every PIT cycle.  Uses the counter latch command
+   so that the two bytes read belong to the same count. */
+uint16_t
+pit_read_count (int channel)
+{
+  enum intr_level old_level;
+  uint8_t low, high;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, channel << 6);
+  low = inb (PIT_PORT_COUNTER (channel));
+  high = inb (PIT_PORT_COUNTER (channel));
+  intr_set_level (old_level);
+
+  return low | (high << 8);
+}
+
+/* Returns the current value of CHANNEL's counter, as
+   pit_read_count() does, and stores the level of the channel's
+   output into *OUTPUT.  Uses the read-back command, which
+   latches the count and the status together, so the two always
+   agree.  In mode 0, the output is high from the moment the
+   count reaches zero until the channel is reprogrammed. */
+uint16_t
+pit_read_status (int channel, bool *output)
+{
+  enum intr_level old_level;
+  uint8_t status, low, high;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, 0xc0 | (1 << (channel + 1)));
+  status = inb (PIT_PORT_COUNTER (channel));
+  low = inb (PIT_PORT_COUNTER (channel));
+  high = inb (PIT_PORT_COUNTER (channel));
+  intr_set_level (old_level);
+
+  *output = (status & 0x80) != 0;
+  return low | (high << 8);
+}
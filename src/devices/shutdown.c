@@ -5,9 +5,19 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
+#include "userprog/process.h"
+#endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/mmap.h"
+#include "vm/page.h"
+#include "vm/share.h"
+#include "vm/swap.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
@@ -130,6 +140,8 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  palloc_print_stats ();
+  kmem_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -137,5 +149,13 @@ print_stats (void)
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
+  process_print_stats ();
+#endif
+#ifdef VM
+  page_print_stats ();
+  frame_print_stats ();
+  share_print_stats ();
+  mmap_print_stats ();
+  swap_print_stats ();
 #endif
 }
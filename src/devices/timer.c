@@ -20,7 +20,52 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-static struct list sleeping_threads;
+/* Tickless idle mode.  See timer_idle_enter(). */
+bool timer_tickless;
+
+/* PIT cycles per timer tick. */
+#define PIT_COUNTS_PER_TICK ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Shortest and longest one-shot we program, in PIT cycles.
+   Whether a one-shot has expired is read from the PIT's output,
+   not guessed from the count.  After expiry the counter wraps
+   around and goes on counting down, which measures how late the
+   expiry is handled as long as that is under 65536 cycles. */
+#define ONESHOT_MIN_COUNT 16
+#define ONESHOT_MAX_COUNT 0xf000
+
+/* Normally the PIT interrupts periodically, once per tick.  To
+   wake a sleeper between ticks, or to skip ticks while the CPU
+   is idle, it is put into one-shot mode instead.  Then
+   oneshot_expiry is the time, in PIT cycles since boot, at which
+   the one-shot fires.  oneshot_expiry is 0 in periodic mode. */
+static int64_t oneshot_expiry;
+
+/* In periodic mode, the time at which the current period ends
+   and the next periodic interrupt arrives.  Periodic mode is
+   entered a little after a tick boundary, because the interrupt
+   that does so is handled late, so periodic interrupts lag the
+   tick boundaries by that much.  Keeping track of it here, rather
+   than pretending that they fall on the boundaries, stops the
+   lag from adding up. */
+static int64_t periodic_next = PIT_COUNTS_PER_TICK;
+
+/* True while the idle thread is halted in tickless mode, so that
+   no tick needs to be delivered before the next sleeper is due. */
+static bool idle_tickless;
+
+/* Sleeping threads, kept in a leftist heap ordered by
+   wake_up_time, in PIT cycles since boot, and linked through the
+   threads' sleep_left and sleep_right members.  Adding a sleeper and removing the
+   earliest one both take O(log n) time in the worst case, so
+   the time spent with interrupts off stays small no matter how
+   many threads are asleep. */
+static struct thread *sleepers;
+
+/* Longest time, in CPU cycles, spent with interrupts off adding
+   a sleeper and waking sleepers, respectively. */
+static uint64_t max_sleep_cycles;
+static uint64_t max_wake_cycles;
 
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
@@ -31,6 +76,13 @@ static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
+static void sleep_until (int64_t wake_up_time);
+static int64_t current_cycles (void);
+static bool oneshot_expired (void);
+static void reprogram (int64_t now);
+static void reprogram_from_thread (void);
+static struct thread *sleepers_merge (struct thread *, struct thread *);
+static uint64_t rdtsc (void);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
@@ -39,7 +91,6 @@ timer_init (void)
 {
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
-  list_init(&sleeping_threads);
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -87,26 +138,99 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
+/* Returns the number of microseconds since the OS booted.
+   Unlike timer_ticks(), this reads the PIT's counter to find out
+   how far the current tick has progressed. */
+int64_t
+timer_usecs (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t cycles = current_cycles ();
+  intr_set_level (old_level);
+  return cycles / PIT_HZ * 1000000 + cycles % PIT_HZ * 1000000 / PIT_HZ;
+}
+
+/* Returns the number of microseconds elapsed since THEN, which
+   should be a value once returned by timer_usecs(). */
+int64_t
+timer_usecs_elapsed (int64_t then) 
+{
+  return timer_usecs () - then;
+}
+
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
    be turned on. */
 void
 timer_sleep (int64_t ticks) 
 {
-  if (ticks <= 0) {
-        return; // No need to sleep
-    }
+  ASSERT (intr_get_level () == INTR_ON);
+  if (ticks > 0)
+    sleep_until ((timer_ticks () + ticks) * PIT_COUNTS_PER_TICK);
+}
+
+/* Blocks the current thread until WAKE_UP_TIME, in PIT cycles
+   since boot.  Interrupts must be turned on. */
+static void
+sleep_until (int64_t wake_up_time) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  uint64_t begin, cycles;
+
+  old_level = intr_disable ();
+  begin = rdtsc ();
+
+  cur->wake_up_time = wake_up_time;
+  cur->sleep_left = cur->sleep_right = NULL;
+  cur->sleep_rank = 1;
+  sleepers = sleepers_merge (sleepers, cur);
+
+  /* A new earliest sleeper that is not due on a tick boundary
+     needs a one-shot; periodic ticks take care of the rest. */
+  if (sleepers == cur
+      && (oneshot_expiry != 0 || wake_up_time % PIT_COUNTS_PER_TICK != 0))
+    reprogram_from_thread ();
+
+  cycles = rdtsc () - begin;
+  if (cycles > max_sleep_cycles)
+    max_sleep_cycles = cycles;
+
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  In tickless mode, stops the periodic timer
+   interrupt until the next sleeper is due, or for as long as the
+   PIT's counter allows, whichever is sooner.
+
+   Not used with the 4.4BSD scheduler, whose bookkeeping is
+   driven by every tick. */
+void
+timer_idle_enter (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (!timer_tickless || thread_mlfqs)
+    return;
+
+  idle_tickless = true;
+  reprogram_from_thread ();
+}
+
+/* Called with interrupts off by the idle thread after it wakes
+   up from halting, and by the scheduler whenever it switches
+   from the idle thread to another.  The thread about to run will
+   need timer ticks, so any tickless one-shot is cut short to
+   expire at the next tick boundary. */
+void
+timer_idle_exit (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (!idle_tickless)
+    return;
 
-    struct thread *cur = thread_current();
-    cur->wake_up_time = timer_ticks() + ticks;  // Directly set wake-up time
-
-    enum intr_level old_level = intr_disable();
-    
-    /* Insert the thread into the sleeping list, ordered by wake-up time */
-    list_insert_ordered(&sleeping_threads, &cur->elem, wake_up_time_less, NULL);
-    
-    /* Block the thread */
-    thread_block();
-    intr_set_level(old_level);
+  idle_tickless = false;
+  reprogram_from_thread ();
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -177,26 +301,256 @@ void
 timer_print_stats (void) 
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+}
+
+/* Stores into *SLEEP_CYCLES and *WAKE_CYCLES the longest time,
+   in CPU cycles, that interrupts have been kept off to add a
+   sleeping thread and to wake sleeping threads in a timer
+   interrupt, then starts measuring afresh. */
+void
+timer_sleep_stats (uint64_t *sleep_cycles, uint64_t *wake_cycles) 
+{
+  enum intr_level old_level = intr_disable ();
+  *sleep_cycles = max_sleep_cycles;
+  *wake_cycles = max_wake_cycles;
+  max_sleep_cycles = max_wake_cycles = 0;
+  intr_set_level (old_level);
 }
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
-    ticks++;
-    thread_tick();
+  int64_t now;
+  uint64_t begin, cycles;
+  bool ticked = false;
+  bool woke = false;
+
+  if (oneshot_expiry == 0)
+    {
+      now = periodic_next;
+      periodic_next += PIT_COUNTS_PER_TICK;
+    }
+  else
+    {
+      /* An interrupt left over from a one-shot that has since
+         been replaced by a later one, which has not expired. */
+      if (!oneshot_expired ())
+        return;
+
+      now = oneshot_expiry;
+    }
+
+  /* Count the ticks up to NOW.  More than one means that the
+     idle thread was halted in tickless mode meanwhile. */
+  if (now / PIT_COUNTS_PER_TICK > ticks)
+    {
+      int64_t skipped = now / PIT_COUNTS_PER_TICK - ticks - 1;
+      ticks += skipped;
+      thread_tick_idle (skipped);
+      ticks++;
+      thread_tick ();
+      ticked = true;
+    }
+
+  /* Wake up sleepers whose time has come.  Only the root of the
+     heap needs to be examined. */
+  begin = rdtsc ();
+  while (sleepers != NULL && sleepers->wake_up_time <= now)
+    {
+      struct thread *t = sleepers;
+      sleepers = sleepers_merge (t->sleep_left, t->sleep_right);
+      thread_unblock (t);
+      woke = true;
+    }
+  cycles = rdtsc () - begin;
+  if (cycles > max_wake_cycles)
+    max_wake_cycles = cycles;
+
+  /* A thread woken between ticks should not have to wait for the
+     end of the current time slice to run.  It needs ticks, too,
+     so tickless mode ends here: the idle thread may be switched
+     out without getting to call timer_idle_exit() first. */
+  if (woke)
+    {
+      idle_tickless = false;
+      if (!ticked)
+        intr_yield_on_return ();
+    }
+
+  reprogram (now);
+}
+
+/* Returns the current time in PIT cycles since boot.  Interrupts
+   must be off. */
+static int64_t
+current_cycles (void) 
+{
+  uint16_t count;
+
+  if (oneshot_expiry != 0)
+    {
+      /* The counter runs down to zero at the expiry, then wraps
+         around and keeps counting down. */
+      bool expired;
+      count = pit_read_status (0, &expired);
+      if (!expired)
+        return oneshot_expiry - count;
+      else
+        return oneshot_expiry + (uint16_t) (0x10000 - count);
+    }
+
+  count = pit_read_count (0);
+  if (!intr_ext_pending (0x20))
+    {
+      /* The counter runs down from PIT_COUNTS_PER_TICK once per
+         tick, to the end of the period at periodic_next. */
+      return periodic_next - count;
+    }
+  else
+    {
+      /* A period has ended but its interrupt is not handled yet. */
+      count = pit_read_count (0);
+      return periodic_next + (PIT_COUNTS_PER_TICK - count);
+    }
+}
 
-    /* Check the sleeping threads list */
-    while (!list_empty(&sleeping_threads)) {
-        struct thread *t = list_entry(list_front(&sleeping_threads), struct thread, elem);
+/* Programs the PIT for the next timer event after NOW, in PIT
+   cycles since boot: the next tick, or the earliest sleeper's
+   wake-up time if that comes first.  While the idle thread is
+   halted in tickless mode, ticks with no sleeper due are
+   skipped.  NOW must be the time of the timer interrupt being
+   handled, or the current time if the PIT is periodic or its
+   one-shot has not expired.  If the PIT is in one-shot mode, it
+   is always reprogrammed.
+
+   By the time the PIT is loaded, the current time is later than
+   NOW, by the latency of the interrupt at least.  The PIT is
+   loaded relative to the current time read back from its
+   counter, not relative to NOW, so that the clock does not fall
+   behind by that much on every reprogramming. */
+static void
+reprogram (int64_t now) 
+{
+  int64_t next_tick = (now / PIT_COUNTS_PER_TICK + 1) * PIT_COUNTS_PER_TICK;
+  int64_t expiry = next_tick;
+  int64_t cur;
 
-        if (t->wake_up_time > ticks) {
-            break; // No threads to wake up yet
+  if (oneshot_expiry == 0 && !idle_tickless)
+    {
+      /* The next periodic interrupt counts the next tick and
+         wakes whoever is due on it.  Only a sleeper due between
+         ticks before then needs a one-shot. */
+      if (sleepers == NULL
+          || sleepers->wake_up_time >= periodic_next
+          || sleepers->wake_up_time % PIT_COUNTS_PER_TICK == 0)
+        return;
+      expiry = sleepers->wake_up_time;
+    }
+  else
+    {
+      if (idle_tickless)
+        {
+          expiry = (now + ONESHOT_MAX_COUNT) / PIT_COUNTS_PER_TICK
+                   * PIT_COUNTS_PER_TICK;
+          if (expiry < next_tick)
+            expiry = next_tick;
+        }
+      if (sleepers != NULL && sleepers->wake_up_time < expiry)
+        expiry = sleepers->wake_up_time;
+
+      /* Periodic interrupts will do from here on.  Switching to
+         periodic mode starts a new period, so it should happen
+         as close after a tick boundary as possible. */
+      if (expiry == next_tick && now % PIT_COUNTS_PER_TICK == 0)
+        {
+          cur = current_cycles ();
+          pit_configure_channel (0, 2, TIMER_FREQ);
+          periodic_next = cur + PIT_COUNTS_PER_TICK;
+          oneshot_expiry = 0;
+          return;
         }
+    }
+
+  cur = current_cycles ();
+  if (expiry < cur + ONESHOT_MIN_COUNT)
+    expiry = cur + ONESHOT_MIN_COUNT;
+  oneshot_expiry = expiry;
+  pit_start_oneshot (0, expiry - cur);
+}
+
+/* Reprograms the PIT from outside the timer interrupt handler,
+   after the set of sleepers or the idle state changed.  If a
+   timer interrupt is already pending, it will do this itself.
+   Interrupts must be off. */
+static void
+reprogram_from_thread (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
 
-        /* Unblock and remove the thread from the sleeping list */
-        list_remove(&t->elem);
-        thread_unblock(t);
+  if (intr_ext_pending (0x20) || (oneshot_expiry != 0 && oneshot_expired ()))
+    return;
+  reprogram (current_cycles ());
+}
+
+/* Returns true if the one-shot now programmed has expired,
+   false if it is still running.  The PIT must be in one-shot
+   mode. */
+static bool
+oneshot_expired (void) 
+{
+  bool expired;
+
+  ASSERT (oneshot_expiry != 0);
+  pit_read_status (0, &expired);
+  return expired;
+}
+
+/* Returns the rank of sleeper heap node T, the length of its
+   rightmost path. */
+static inline int
+sleeper_rank (const struct thread *t) 
+{
+  return t != NULL ? t->sleep_rank : 0;
+}
+
+/* Merges sleeper heaps A and B and returns the new root.  Only
+   the right spines are walked, and a leftist heap of n nodes has
+   a right spine of at most log2(n + 1) nodes. */
+static struct thread *
+sleepers_merge (struct thread *a, struct thread *b) 
+{
+  struct thread *tmp;
+
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+
+  if (b->wake_up_time < a->wake_up_time)
+    {
+      tmp = a;
+      a = b;
+      b = tmp;
+    }
+
+  a->sleep_right = sleepers_merge (a->sleep_right, b);
+  if (sleeper_rank (a->sleep_left) < sleeper_rank (a->sleep_right))
+    {
+      tmp = a->sleep_left;
+      a->sleep_left = a->sleep_right;
+      a->sleep_right = tmp;
     }
+  a->sleep_rank = sleeper_rank (a->sleep_right) + 1;
+  return a;
+}
+
+/* Returns the value of the CPU's time-stamp counter. */
+static uint64_t
+rdtsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -232,32 +586,35 @@ busy_wait (int64_t loops)
     barrier ();
 }
 
-/* Sleep for approximately NUM/DENOM seconds. */
+/* Sleep for at least NUM/DENOM seconds.  Rather than rounding to
+   whole ticks, the thread blocks until the exact PIT cycle,
+   using a one-shot timer interrupt if that falls between ticks.
+   Intervals too short to be worth a one-shot are busy-waited
+   instead. */
 static void
 real_time_sleep (int64_t num, int32_t denom) 
 {
-  /* Convert NUM/DENOM seconds into timer ticks, rounding down.
-          
-        (NUM / DENOM) s          
-     ---------------------- = NUM * TIMER_FREQ / DENOM ticks. 
-     1 s / TIMER_FREQ ticks
-  */
-  int64_t ticks = num * TIMER_FREQ / denom;
+  /* Convert NUM/DENOM seconds into PIT cycles, rounding up.
+     Whole seconds are converted separately to avoid overflow. */
+  int64_t cycles = (num / denom * PIT_HZ
+                    + DIV_ROUND_UP (num % denom * PIT_HZ, denom));
+  enum intr_level old_level;
+  int64_t now;
 
   ASSERT (intr_get_level () == INTR_ON);
-  if (ticks > 0)
-    {
-      /* We're waiting for at least one full timer tick.  Use
-         timer_sleep() because it will yield the CPU to other
-         processes. */                
-      timer_sleep (ticks); 
-    }
-  else 
+  if (num <= 0)
+    return;
+  if (cycles < ONESHOT_MIN_COUNT)
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing. */
-      real_time_delay (num, denom); 
+      real_time_delay (num, denom);
+      return;
     }
+
+  old_level = intr_disable ();
+  now = current_cycles ();
+  intr_set_level (old_level);
+
+  sleep_until (now + cycles);
 }
 
 /* Busy-wait for approximately NUM/DENOM seconds. */
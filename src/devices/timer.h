@@ -2,16 +2,26 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* If false (default), the timer interrupts TIMER_FREQ times per
+   second at all times.
+   If true, the timer is stopped while the CPU is idle and only
+   restarted for the next sleeping thread's wake-up time.
+   Controlled by kernel command-line option "-tickless". */
+extern bool timer_tickless;
+
 void timer_init (void);
 void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_usecs (void);
+int64_t timer_usecs_elapsed (int64_t);
 
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
@@ -24,6 +34,11 @@ void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
+/* Tickless idle support, for the idle thread. */
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
 void timer_print_stats (void);
+void timer_sleep_stats (uint64_t *sleep_cycles, uint64_t *wake_cycles);
 
 #endif /* devices/timer.h */
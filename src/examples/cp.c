@@ -5,10 +5,34 @@ Copies one file to another. */
 #include <stdio.h>
 #include <syscall.h>
 
+/* Each read is paired with a write of the same buffer, so a batch
+   copies up to this many blocks with a single system call. */
+#define BLOCK_SIZE 4096
+#define BATCH_BLOCKS (IO_RING_SIZE / 2)
+
+static char buffers[BATCH_BLOCKS][BLOCK_SIZE];
+static struct io_ring ring;
+
+/* Queues OP of LEN bytes between FD at offset OFS and BUF. */
+static void
+submit (enum io_op op, int fd, void *buf, unsigned len, int ofs)
+{
+  struct io_sqe *sqe = &ring.sq[ring.sq_tail % IO_RING_SIZE];
+
+  sqe->op = op;
+  sqe->fd = fd;
+  sqe->buf = buf;
+  sqe->len = len;
+  sqe->ofs = ofs;
+  sqe->user_data = len;
+  ring.sq_tail++;
+}
+
 int
 main (int argc, char *argv[]) 
 {
   int in_fd, out_fd;
+  int size, ofs;
 
   if (argc != 3) 
     {
@@ -37,18 +61,36 @@ main (int argc, char *argv[])
       return EXIT_FAILURE;
     }
 
-  /* Copy data. */
-  for (;;) 
+  /* Copy data.  The kernel carries out each batch in order, so
+     every write sees the data its read brought in. */
+  size = filesize (in_fd);
+  for (ofs = 0; ofs < size; ) 
     {
-      char buffer[1024];
-      int bytes_read = read (in_fd, buffer, sizeof buffer);
-      if (bytes_read == 0)
-        break;
-      if (write (out_fd, buffer, bytes_read) != bytes_read) 
+      int cnt = 0;
+      int i;
+
+      for (i = 0; i < BATCH_BLOCKS && ofs < size; i++, ofs += BLOCK_SIZE)
+        {
+          int len = size - ofs < BLOCK_SIZE ? size - ofs : BLOCK_SIZE;
+          submit (IO_READ, in_fd, buffers[i], len, ofs);
+          submit (IO_WRITE, out_fd, buffers[i], len, ofs);
+          cnt += 2;
+        }
+      if (io_ring_enter (&ring) != cnt)
         {
-          printf ("%s: write failed\n", argv[2]);
+          printf ("%s: copy failed\n", argv[2]);
           return EXIT_FAILURE;
         }
+      for (i = 0; i < cnt; i++) 
+        {
+          struct io_cqe *cqe = &ring.cq[ring.cq_head++ % IO_RING_SIZE];
+          if (cqe->result != (int) cqe->user_data) 
+            {
+              printf ("%s: %s failed\n",
+                      i % 2 ? argv[2] : argv[1], i % 2 ? "write" : "read");
+              return EXIT_FAILURE;
+            }
+        }
     }
 
   return EXIT_SUCCESS;
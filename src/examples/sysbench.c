@@ -0,0 +1,115 @@
+/* sysbench.c
+
+   Measures system call latency, in CPU cycles per call: tell(),
+   which does almost nothing in the kernel, entering the kernel
+   with `int $0x30' and then with SYSENTER, then reads and writes
+   of a scratch file at sizes from 1 byte to 16 kB.
+
+   Usage: sysbench [FILE], where FILE is the scratch file to
+   create, "sysbench.tmp" by default. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <syscall.h>
+
+/* Size of the scratch file. */
+#define FILE_SIZE (64 * 1024)
+
+/* Calls timed per measurement. */
+#define REPS 256
+
+static char buf[16 * 1024];
+
+/* Reads the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns the cycles per call for REPS calls of tell() on FD. */
+static unsigned
+time_tell (int fd)
+{
+  uint64_t start, cycles;
+  int i;
+
+  start = rdtsc ();
+  for (i = 0; i < REPS; i++)
+    tell (fd);
+  cycles = rdtsc () - start;
+  return cycles / REPS;
+}
+
+/* Returns the cycles per call for REPS calls of read() or, if
+   WRITING is true, write() of SIZE bytes on FD, wrapping around
+   to the start of the file when it runs out. */
+static unsigned
+time_io (int fd, size_t size, bool writing)
+{
+  unsigned position = 0;
+  uint64_t start, cycles;
+  int i;
+
+  seek (fd, 0);
+  start = rdtsc ();
+  for (i = 0; i < REPS; i++)
+    {
+      if (position + size > FILE_SIZE)
+        {
+          seek (fd, 0);
+          position = 0;
+        }
+      if ((writing
+           ? write (fd, buf, size)
+           : read (fd, buf, size)) != (int) size)
+        {
+          printf ("sysbench: %s failed\n", writing ? "write" : "read");
+          exit (1);
+        }
+      position += size;
+    }
+  cycles = rdtsc () - start;
+  return cycles / REPS;
+}
+
+int
+main (int argc, char *argv[])
+{
+  const char *name = argc > 1 ? argv[1] : "sysbench.tmp";
+  size_t size;
+  int fd;
+
+  if (!create (name, FILE_SIZE))
+    {
+      printf ("sysbench: %s: create failed\n", name);
+      return 1;
+    }
+  fd = open (name);
+  if (fd < 0)
+    {
+      printf ("sysbench: %s: open failed\n", name);
+      return 1;
+    }
+
+  syscall_set_entry (SYSCALL_INT);
+  printf ("tell, int $0x30: %u cycles per call\n", time_tell (fd));
+  if (syscall_set_entry (SYSCALL_SYSENTER))
+    printf ("tell, sysenter: %u cycles per call\n", time_tell (fd));
+  else
+    printf ("tell, sysenter: not supported\n");
+
+  printf ("%8s %10s %10s\n", "size", "read", "write");
+  for (size = 1; size <= sizeof buf; size *= 4)
+    {
+      unsigned read_cycles = time_io (fd, size, false);
+      unsigned write_cycles = time_io (fd, size, true);
+      printf ("%8zu %10u %10u\n", size, read_cycles, write_cycles);
+    }
+
+  close (fd);
+  remove (name);
+  return 0;
+}
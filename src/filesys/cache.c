@@ -0,0 +1,300 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Number of sectors in the buffer cache. */
+#define CACHE_SIZE 64
+
+/* Ticks between passes of the write-behind thread. */
+#define WRITE_BEHIND_TICKS TIMER_FREQ
+
+/* Maximum number of queued read-ahead requests.  Requests that
+   arrive while the queue is full are dropped. */
+#define READ_AHEAD_SIZE 16
+
+/* A cached sector of the file system device.
+
+   SECTOR, VALID, ACCESSED, and USERS are protected by
+   cache_lock.  DATA and DIRTY are protected by RW, which is only
+   ever acquired by a thread that has first counted itself in
+   USERS, so an entry with USERS == 0 is not locked or waited on
+   by anyone and may be evicted. */
+struct cache_entry
+  {
+    block_sector_t sector;              /* Sector number of DATA. */
+    bool valid;                         /* Does DATA hold SECTOR? */
+    bool accessed;                      /* Used since last clock pass? */
+    int users;                          /* Threads holding or awaiting RW. */
+    bool dirty;                         /* DATA newer than disk? */
+    struct rwlock rw;                   /* Protects DATA and DIRTY. */
+    uint8_t data[BLOCK_SECTOR_SIZE];    /* Sector contents. */
+  };
+
+static struct cache_entry cache[CACHE_SIZE];
+static struct lock cache_lock;          /* Protects entry mappings. */
+static size_t clock_hand;               /* Next eviction candidate. */
+
+/* Queue of sectors to read ahead. */
+static block_sector_t read_ahead_queue[READ_AHEAD_SIZE];
+static size_t read_ahead_head, read_ahead_cnt;
+static struct lock read_ahead_lock;
+static struct semaphore read_ahead_sema;
+
+static struct cache_entry *cache_acquire (block_sector_t, bool exclusive,
+                                          bool load, bool count);
+static void cache_release (struct cache_entry *, bool exclusive);
+static thread_func write_behind_daemon NO_RETURN;
+static thread_func read_ahead_daemon NO_RETURN;
+
+/* Initializes the buffer cache and starts its write-behind and
+   read-ahead threads. */
+void
+cache_init (void) 
+{
+  size_t i;
+
+  lock_init (&cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      cache[i].valid = false;
+      cache[i].users = 0;
+      cache[i].dirty = false;
+      rwlock_init (&cache[i].rw);
+    }
+
+  lock_init (&read_ahead_lock);
+  sema_init (&read_ahead_sema, 0);
+
+  thread_create ("cache-flush", PRI_DEFAULT, write_behind_daemon, NULL);
+  thread_create ("cache-read", PRI_DEFAULT, read_ahead_daemon, NULL);
+}
+
+/* Copies SIZE bytes starting at byte offset OFS within SECTOR
+   into BUFFER, reading SECTOR into the cache if necessary. */
+void
+cache_read_at (block_sector_t sector, void *buffer, int ofs, int size) 
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = cache_acquire (sector, false, true, true);
+  memcpy (buffer, e->data + ofs, size);
+  cache_release (e, false);
+}
+
+/* Copies SIZE bytes from BUFFER into SECTOR starting at byte
+   offset OFS.  The data reaches the disk when the sector is
+   evicted or the cache is flushed.  If the write covers the
+   whole sector, the sector is not read from disk first. */
+void
+cache_write_at (block_sector_t sector, const void *buffer, int ofs, int size) 
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = cache_acquire (sector, true, size < BLOCK_SECTOR_SIZE, true);
+  memcpy (e->data + ofs, buffer, size);
+  e->dirty = true;
+  cache_release (e, true);
+}
+
+/* Asks for SECTOR to be brought into the cache in the
+   background.  Returns without waiting for the read. */
+void
+cache_read_ahead (block_sector_t sector) 
+{
+  lock_acquire (&read_ahead_lock);
+  if (read_ahead_cnt < READ_AHEAD_SIZE)
+    {
+      read_ahead_queue[(read_ahead_head + read_ahead_cnt++)
+                       % READ_AHEAD_SIZE] = sector;
+      sema_up (&read_ahead_sema);
+    }
+  lock_release (&read_ahead_lock);
+}
+
+/* Writes every dirty sector in the cache back to disk. */
+void
+cache_flush (void) 
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+
+      lock_acquire (&cache_lock);
+      if (!e->valid || !e->dirty)
+        {
+          lock_release (&cache_lock);
+          continue;
+        }
+      e->users++;
+      lock_release (&cache_lock);
+
+      rwlock_acquire_read (&e->rw);
+      if (e->dirty)
+        {
+          block_write (fs_device, e->sector, e->data);
+          e->dirty = false;
+        }
+      cache_release (e, false);
+    }
+}
+
+/* Chooses an entry to hold a new sector, using the clock
+   algorithm over entries that no thread is using, and writes it
+   back if it is dirty.  Returns a null pointer if every entry is
+   in use.  Must be called with cache_lock held. */
+static struct cache_entry *
+cache_evict (void) 
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  /* Two full turns: the first may only clear accessed bits. */
+  for (i = 0; i < 2 * CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[clock_hand];
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+
+      if (e->users > 0)
+        continue;
+      if (e->valid && e->accessed)
+        {
+          e->accessed = false;
+          continue;
+        }
+
+      /* Writing back under cache_lock keeps anyone from
+         missing on this sector and reading stale data from disk
+         before the write completes. */
+      if (e->valid && e->dirty)
+        block_write (fs_device, e->sector, e->data);
+      e->valid = false;
+      e->dirty = false;
+      return e;
+    }
+  return NULL;
+}
+
+/* Returns the cache entry for SECTOR, locked for writing if
+   EXCLUSIVE is true or for reading otherwise.  If SECTOR is not
+   cached, evicts another entry for it and, if LOAD is true, reads
+   it from disk.  If COUNT is true, the access is recorded in the
+   device's cache statistics. */
+static struct cache_entry *
+cache_acquire (block_sector_t sector, bool exclusive, bool load, bool count) 
+{
+  struct cache_entry *e;
+  size_t i;
+
+  for (;;)
+    {
+      lock_acquire (&cache_lock);
+
+      /* Hit. */
+      for (i = 0; i < CACHE_SIZE; i++)
+        {
+          e = &cache[i];
+          if (e->valid && e->sector == sector)
+            {
+              e->users++;
+              e->accessed = true;
+              lock_release (&cache_lock);
+
+              if (count)
+                block_count_cache_access (fs_device, true);
+              if (exclusive)
+                rwlock_acquire_write (&e->rw);
+              else
+                rwlock_acquire_read (&e->rw);
+              return e;
+            }
+        }
+
+      /* Miss.  Take the write lock on the new entry before
+         releasing cache_lock, so that other threads looking up
+         SECTOR wait until it has been loaded. */
+      e = cache_evict ();
+      if (e != NULL)
+        {
+          e->sector = sector;
+          e->valid = true;
+          e->accessed = true;
+          e->users = 1;
+          rwlock_acquire_write (&e->rw);
+          lock_release (&cache_lock);
+
+          if (count)
+            block_count_cache_access (fs_device, false);
+          if (load)
+            block_read (fs_device, sector, e->data);
+          if (!exclusive)
+            {
+              rwlock_release_write (&e->rw);
+              rwlock_acquire_read (&e->rw);
+            }
+          return e;
+        }
+
+      /* Every entry is in use.  Let their users finish. */
+      lock_release (&cache_lock);
+      thread_yield ();
+    }
+}
+
+/* Releases cache entry E, which was acquired for writing if
+   EXCLUSIVE is true or for reading otherwise. */
+static void
+cache_release (struct cache_entry *e, bool exclusive) 
+{
+  if (exclusive)
+    rwlock_release_write (&e->rw);
+  else
+    rwlock_release_read (&e->rw);
+
+  lock_acquire (&cache_lock);
+  ASSERT (e->users > 0);
+  e->users--;
+  lock_release (&cache_lock);
+}
+
+/* Write-behind thread.  Periodically flushes dirty sectors so
+   that a crash loses at most a few seconds of writes. */
+static void
+write_behind_daemon (void *aux UNUSED) 
+{
+  for (;;)
+    {
+      timer_sleep (WRITE_BEHIND_TICKS);
+      cache_flush ();
+    }
+}
+
+/* Read-ahead thread.  Loads queued sectors into the cache. */
+static void
+read_ahead_daemon (void *aux UNUSED) 
+{
+  for (;;)
+    {
+      block_sector_t sector;
+
+      sema_down (&read_ahead_sema);
+      lock_acquire (&read_ahead_lock);
+      sector = read_ahead_queue[read_ahead_head];
+      read_ahead_head = (read_ahead_head + 1) % READ_AHEAD_SIZE;
+      read_ahead_cnt--;
+      lock_release (&read_ahead_lock);
+
+      cache_release (cache_acquire (sector, false, true, false), false);
+    }
+}
@@ -4,7 +4,7 @@
 #include <list.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 
 /* A directory. */
 struct dir 
@@ -21,6 +21,16 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Cache of `struct dir's. */
+static struct kmem_cache *dir_cache;
+
+/* Initializes the directory module. */
+void
+dir_init (void) 
+{
+  dir_cache = kmem_cache_create ("dir", sizeof (struct dir), 0, NULL);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
@@ -34,7 +44,7 @@ dir_create (block_sector_t sector, size_t entry_cnt)
 struct dir *
 dir_open (struct inode *inode) 
 {
-  struct dir *dir = calloc (1, sizeof *dir);
+  struct dir *dir = kmem_cache_alloc (dir_cache);
   if (inode != NULL && dir != NULL)
     {
       dir->inode = inode;
@@ -44,7 +54,7 @@ dir_open (struct inode *inode)
   else
     {
       inode_close (inode);
-      free (dir);
+      kmem_cache_free (dir_cache, dir);
       return NULL; 
     }
 }
@@ -72,7 +82,7 @@ dir_close (struct dir *dir)
   if (dir != NULL)
     {
       inode_close (dir->inode);
-      free (dir);
+      kmem_cache_free (dir_cache, dir);
     }
 }
 
@@ -152,7 +162,10 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
-  /* Check that NAME is not in use. */
+  /* Check that NAME is not in use.  Holding the directory's lock
+     until the entry is written keeps another thread from adding
+     the same name, or taking the same free slot, meanwhile. */
+  inode_lock (dir->inode);
   if (lookup (dir, name, NULL, NULL))
     goto done;
 
@@ -175,6 +188,7 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
  done:
+  inode_unlock (dir->inode);
   return success;
 }
 
@@ -193,6 +207,7 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (name != NULL);
 
   /* Find directory entry. */
+  inode_lock (dir->inode);
   if (!lookup (dir, name, &e, &ofs))
     goto done;
 
@@ -211,6 +226,7 @@ dir_remove (struct dir *dir, const char *name)
   success = true;
 
  done:
+  inode_unlock (dir->inode);
   inode_close (inode);
   return success;
 }
@@ -1,34 +1,60 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
-/* An open file. */
+/* An open file.
+
+   Open files make up the system-wide open-file table: every
+   holder of a reference, such as a process's file descriptor or
+   a memory mapping, points directly to its `struct file', so
+   there is no central index to search.  Holders that share a
+   `struct file' through file_dup() share its position too.
+   POS and DENY_WRITE are not locked, because only the process
+   that opened a file uses them; the inode locks everything that
+   processes share. */
 struct file 
   {
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    int ref_cnt;                /* References, protected by ref_lock. */
   };
 
+/* Cache of `struct file's. */
+static struct kmem_cache *file_cache;
+
+/* Protects every open file's REF_CNT. */
+static struct lock ref_lock;
+
+/* Initializes the file module. */
+void
+file_init (void) 
+{
+  file_cache = kmem_cache_create ("file", sizeof (struct file), 0, NULL);
+  lock_init (&ref_lock);
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) 
 {
-  struct file *file = calloc (1, sizeof *file);
+  struct file *file = kmem_cache_alloc (file_cache);
   if (inode != NULL && file != NULL)
     {
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ref_cnt = 1;
       return file;
     }
   else
     {
       inode_close (inode);
-      free (file);
+      kmem_cache_free (file_cache, file);
       return NULL; 
     }
 }
@@ -41,15 +67,35 @@ file_reopen (struct file *file)
   return file_open (inode_reopen (file->inode));
 }
 
-/* Closes FILE. */
+/* Returns a new reference to FILE itself, which shares FILE's
+   position.  Each reference must be closed with file_close(). */
+struct file *
+file_dup (struct file *file) 
+{
+  lock_acquire (&ref_lock);
+  file->ref_cnt++;
+  lock_release (&ref_lock);
+  return file;
+}
+
+/* Closes a reference to FILE, and FILE itself if it was the
+   last. */
 void
 file_close (struct file *file) 
 {
   if (file != NULL)
     {
+      bool last;
+
+      lock_acquire (&ref_lock);
+      last = --file->ref_cnt == 0;
+      lock_release (&ref_lock);
+      if (!last)
+        return;
+
       file_allow_write (file);
       inode_close (file->inode);
-      free (file); 
+      kmem_cache_free (file_cache, file); 
     }
 }
 
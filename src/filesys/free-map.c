@@ -1,12 +1,105 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* The free map is divided into groups of sectors, each of which
+   is described by one sector of the free map file.  Per-group
+   free counts let allocation skip over full groups, and only the
+   groups that an allocation or release touches are written back
+   to the free map file. */
+#define GROUP_SECTORS (BLOCK_SECTOR_SIZE * 8)
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static size_t group_cnt;             /* Number of groups. */
+static size_t *group_free;           /* Free sectors in each group. */
+static size_t free_cnt;              /* Free sectors in all groups. */
+static block_sector_t next_fit;      /* Where the next search starts. */
+
+/* Protects all of the above once the file system is running.
+   Writing a changed group to the free map file takes the free map
+   inode's lock, and that file never grows, so this lock is never
+   wanted again from inside. */
+static struct lock free_map_lock;
+
+/* Recomputes the free counts from the free map. */
+static void
+count_free (void) 
+{
+  size_t i;
+
+  free_cnt = 0;
+  for (i = 0; i < group_cnt; i++)
+    {
+      size_t start = i * GROUP_SECTORS;
+      size_t cnt = bitmap_size (free_map) - start;
+      if (cnt > GROUP_SECTORS)
+        cnt = GROUP_SECTORS;
+      group_free[i] = bitmap_count (free_map, start, cnt, false);
+      free_cnt += group_free[i];
+    }
+}
+
+/* Sets the CNT sectors starting at SECTOR to ALLOCATED in the
+   free map, keeping the free counts up to date, and writes the
+   groups that changed to the free map file, if it is open.
+   Returns true if successful, false if the free map file could
+   not be written. */
+static bool
+mark (block_sector_t sector, size_t cnt, bool allocated) 
+{
+  size_t first, end, i;
+
+  bitmap_set_multiple (free_map, sector, cnt, allocated);
+  for (i = sector; i < sector + cnt; )
+    {
+      size_t group = i / GROUP_SECTORS;
+      size_t group_end = (group + 1) * GROUP_SECTORS;
+      size_t n = (sector + cnt < group_end ? sector + cnt : group_end) - i;
+
+      if (allocated)
+        group_free[group] -= n;
+      else
+        group_free[group] += n;
+      i += n;
+    }
+  if (allocated)
+    free_cnt -= cnt;
+  else
+    free_cnt += cnt;
+
+  if (free_map_file == NULL)
+    return true;
+  first = ROUND_DOWN (sector, GROUP_SECTORS);
+  end = ROUND_UP (sector + cnt, GROUP_SECTORS);
+  if (end > bitmap_size (free_map))
+    end = bitmap_size (free_map);
+  return bitmap_write_range (free_map, free_map_file, first, end - first);
+}
+
+/* Returns the first sector of the first run of CNT free sectors
+   that starts at or after START and ends at or before END, or
+   BITMAP_ERROR if there is none. */
+static size_t
+find_free (size_t start, size_t end, size_t cnt) 
+{
+  size_t sector;
+
+  /* No run of free sectors can include part of a full group. */
+  while (start < end && group_free[start / GROUP_SECTORS] == 0)
+    start = ROUND_DOWN (start, GROUP_SECTORS) + GROUP_SECTORS;
+  if (start >= end || end - start < cnt)
+    return BITMAP_ERROR;
+
+  sector = bitmap_scan (free_map, start, cnt, false);
+  return sector != BITMAP_ERROR && sector + cnt <= end ? sector : BITMAP_ERROR;
+}
 
 /* Initializes the free map. */
 void
@@ -15,38 +108,74 @@ free_map_init (void)
   free_map = bitmap_create (block_size (fs_device));
   if (free_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
+  lock_init (&free_map_lock);
+  group_cnt = DIV_ROUND_UP (bitmap_size (free_map), GROUP_SECTORS);
+  group_free = malloc (group_cnt * sizeof *group_free);
+  if (group_free == NULL)
+    PANIC ("free map group allocation failed");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  count_free ();
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
+   the first into *SECTORP.  Searches onward from where the last
+   allocation ended.
    Returns true if successful, false if not enough consecutive
    sectors were available or if the free_map file could not be
    written. */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  return free_map_allocate_near (cnt, next_fit, sectorp);
+}
+
+/* Like free_map_allocate(), but tries to allocate the CNT
+   sectors at or just after sector HINT, for example just after
+   the last sector of a file that is growing. */
+bool
+free_map_allocate_near (size_t cnt, block_sector_t hint,
+                        block_sector_t *sectorp)
+{
+  size_t size = bitmap_size (free_map);
+  size_t sector;
+  bool success = false;
+
+  lock_acquire (&free_map_lock);
+  if (cnt > free_cnt)
+    goto done;
+  if (hint >= size)
+    hint = 0;
+
+  /* Search from HINT to the end of the disk, then wrap around. */
+  sector = find_free (hint, size, cnt);
+  if (sector == BITMAP_ERROR)
+    sector = find_free (0, hint + cnt - 1 < size ? hint + cnt - 1 : size, cnt);
+  if (sector == BITMAP_ERROR)
+    goto done;
+
+  if (!mark (sector, cnt, true))
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      mark (sector, cnt, false);
+      goto done;
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
-  return sector != BITMAP_ERROR;
+  next_fit = sector + cnt;
+  *sectorp = sector;
+  success = true;
+
+ done:
+  lock_release (&free_map_lock);
+  return success;
 }
 
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
-  bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  mark (sector, cnt, false);
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -58,6 +187,7 @@ free_map_open (void)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  count_free ();
 }
 
 /* Writes the free map to disk and closes the free map file. */
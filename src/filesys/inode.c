@@ -3,23 +3,54 @@
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of sector numbers in an index block. */
+#define PTRS_PER_SECTOR (BLOCK_SECTOR_SIZE / sizeof (block_sector_t))
+
+/* Number of data sectors reached through each part of the index. */
+#define DIRECT_CNT 124
+#define INDIRECT_CNT PTRS_PER_SECTOR
+#define DOUBLY_INDIRECT_CNT (PTRS_PER_SECTOR * PTRS_PER_SECTOR)
+
+/* Largest possible file, in bytes (a little over 8 MB). */
+#define INODE_MAX_LENGTH \
+  ((off_t) (DIRECT_CNT + INDIRECT_CNT + DOUBLY_INDIRECT_CNT) \
+   * BLOCK_SECTOR_SIZE)
+
+/* Marks a hole in a file: a data sector that has never been
+   written, which reads as zeros.  Sector 0 holds the free map's
+   inode, so it can never be a data or index sector. */
+#define NO_SECTOR ((block_sector_t) 0)
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   Sector I of the file is DIRECT[I] for I < DIRECT_CNT; the next
+   INDIRECT_CNT sectors are listed in the index block INDIRECT;
+   and the rest are listed in the index blocks that
+   DOUBLY_INDIRECT lists.  NO_SECTOR in any of these places marks
+   a hole. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
+    block_sector_t direct[DIRECT_CNT];  /* Direct data sectors. */
+    block_sector_t indirect;            /* Indirect index block. */
+    block_sector_t doubly_indirect;     /* Doubly indirect index block. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
   };
 
+/* A sector's worth of zeros. */
+static const char zeros[BLOCK_SECTOR_SIZE];
+
 /* Returns the number of sectors to allocate for an inode SIZE
    bytes long. */
 static inline size_t
@@ -28,7 +59,15 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
-/* In-memory inode. */
+/* In-memory inode.
+
+   ELEM, OPEN_CNT, and REMOVED are protected by open_inodes_lock.
+   DATA and DENY_WRITE_CNT are protected by RW: reads of the file
+   hold it shared, so readers of one file proceed in parallel,
+   and writes, which may allocate sectors and change the length,
+   hold it exclusively.  READ_END is only a read-ahead hint, so
+   concurrent readers update it without exclusion.  LOCK is for
+   the directory layer; see inode_lock(). */
 struct inode 
   {
     struct list_elem elem;              /* Element in inode list. */
@@ -36,19 +75,201 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    off_t read_end;                     /* End of last read, for read-ahead. */
+    struct rwlock rw;                   /* Protects DATA, DENY_WRITE_CNT. */
+    struct lock lock;                   /* See inode_lock(). */
     struct inode_disk data;             /* Inode content. */
   };
 
+/* Returns entry IDX of the index block in SECTOR. */
+static block_sector_t
+index_read (block_sector_t sector, size_t idx) 
+{
+  block_sector_t entry;
+
+  cache_read_at (sector, &entry, idx * sizeof entry, sizeof entry);
+  return entry;
+}
+
+/* Sets entry IDX of the index block in SECTOR to ENTRY. */
+static void
+index_write (block_sector_t sector, size_t idx, block_sector_t entry) 
+{
+  cache_write_at (sector, &entry, idx * sizeof entry, sizeof entry);
+}
+
+/* Allocates a sector, fills it with zeros, and stores its number
+   into *SECTORP.  Returns true if successful, false if the disk
+   is full. */
+static bool
+allocate_zeroed (block_sector_t *sectorp) 
+{
+  if (!free_map_allocate (1, sectorp))
+    return false;
+  cache_write_at (*sectorp, zeros, 0, BLOCK_SECTOR_SIZE);
+  return true;
+}
+
+/* Returns the sector that holds sector IDX of the file described
+   by DISK, or NO_SECTOR if that sector is a hole. */
+static block_sector_t
+index_lookup (const struct inode_disk *disk, size_t idx) 
+{
+  block_sector_t table;
+
+  if (idx < DIRECT_CNT)
+    return disk->direct[idx];
+  idx -= DIRECT_CNT;
+
+  if (idx < INDIRECT_CNT)
+    return (disk->indirect != NO_SECTOR
+            ? index_read (disk->indirect, idx) : NO_SECTOR);
+  idx -= INDIRECT_CNT;
+
+  ASSERT (idx < DOUBLY_INDIRECT_CNT);
+  if (disk->doubly_indirect == NO_SECTOR)
+    return NO_SECTOR;
+  table = index_read (disk->doubly_indirect, idx / PTRS_PER_SECTOR);
+  return (table != NO_SECTOR
+          ? index_read (table, idx % PTRS_PER_SECTOR) : NO_SECTOR);
+}
+
+/* Records SECTOR as the sector that holds sector IDX of the file
+   described by DISK, allocating index blocks as needed.  Returns
+   true if successful, false if an index block could not be
+   allocated. */
+static bool
+index_install (struct inode_disk *disk, size_t idx, block_sector_t sector) 
+{
+  block_sector_t table;
+
+  if (idx < DIRECT_CNT)
+    {
+      disk->direct[idx] = sector;
+      return true;
+    }
+  idx -= DIRECT_CNT;
+
+  if (idx < INDIRECT_CNT)
+    {
+      if (disk->indirect == NO_SECTOR && !allocate_zeroed (&disk->indirect))
+        return false;
+      index_write (disk->indirect, idx, sector);
+      return true;
+    }
+  idx -= INDIRECT_CNT;
+
+  ASSERT (idx < DOUBLY_INDIRECT_CNT);
+  if (disk->doubly_indirect == NO_SECTOR
+      && !allocate_zeroed (&disk->doubly_indirect))
+    return false;
+  table = index_read (disk->doubly_indirect, idx / PTRS_PER_SECTOR);
+  if (table == NO_SECTOR)
+    {
+      if (!allocate_zeroed (&table))
+        return false;
+      index_write (disk->doubly_indirect, idx / PTRS_PER_SECTOR, table);
+    }
+  index_write (table, idx % PTRS_PER_SECTOR, sector);
+  return true;
+}
+
+/* Allocates zeroed sectors for every hole among sectors START
+   through END - 1 of the file described by DISK.  Each run of
+   holes is allocated as one contiguous extent if the free map
+   has room for it, or as a few shorter extents if not, so that
+   the file can be read back sequentially.  Each extent is placed
+   just after the data sector before it in the file, if any, or
+   otherwise near HINT.  Returns true if successful, false if the
+   disk filled up, in which case the sectors allocated so far stay
+   in the file. */
+static bool
+inode_allocate (struct inode_disk *disk, size_t start, size_t end,
+                block_sector_t hint) 
+{
+  size_t idx = start;
+
+  while (idx < end)
+    {
+      block_sector_t first, prev;
+      size_t run, i;
+
+      if (index_lookup (disk, idx) != NO_SECTOR)
+        {
+          idx++;
+          continue;
+        }
+
+      /* Find the length of this run of holes, then allocate as
+         much of it contiguously as the free map allows. */
+      for (run = 1; idx + run < end; run++)
+        if (index_lookup (disk, idx + run) != NO_SECTOR)
+          break;
+      prev = idx > 0 ? index_lookup (disk, idx - 1) : NO_SECTOR;
+      if (prev != NO_SECTOR)
+        hint = prev + 1;
+      while (!free_map_allocate_near (run, hint, &first))
+        {
+          if (run == 1)
+            return false;
+          run /= 2;
+        }
+
+      for (i = 0; i < run; i++)
+        {
+          cache_write_at (first + i, zeros, 0, BLOCK_SECTOR_SIZE);
+          if (!index_install (disk, idx + i, first + i))
+            {
+              free_map_release (first + i, run - i);
+              return false;
+            }
+        }
+      idx += run;
+    }
+  return true;
+}
+
+/* Releases SECTOR and, if it is an index block with LEVELS
+   levels of index below it, every sector it refers to. */
+static void
+release_tree (block_sector_t sector, int levels) 
+{
+  if (sector == NO_SECTOR)
+    return;
+
+  if (levels > 0)
+    {
+      size_t i;
+
+      for (i = 0; i < PTRS_PER_SECTOR; i++)
+        release_tree (index_read (sector, i), levels - 1);
+    }
+  free_map_release (sector, 1);
+}
+
+/* Releases every data and index sector of the file described by
+   DISK. */
+static void
+inode_deallocate (struct inode_disk *disk) 
+{
+  size_t i;
+
+  for (i = 0; i < DIRECT_CNT; i++)
+    release_tree (disk->direct[i], 0);
+  release_tree (disk->indirect, 1);
+  release_tree (disk->doubly_indirect, 2);
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   POS, or NO_SECTOR if POS lies in a hole. */
 static block_sector_t
 byte_to_sector (const struct inode *inode, off_t pos) 
 {
   ASSERT (inode != NULL);
   if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
+    return index_lookup (&inode->data, pos / BLOCK_SECTOR_SIZE);
   else
     return -1;
 }
@@ -56,12 +277,18 @@ byte_to_sector (const struct inode *inode, off_t pos)
 /* List of open inodes, so that opening a single inode twice
    returns the same `struct inode'. */
 static struct list open_inodes;
+static struct lock open_inodes_lock;
+
+/* Cache of `struct inode's. */
+static struct kmem_cache *inode_cache;
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  lock_init (&open_inodes_lock);
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode), 0, NULL);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -76,6 +303,8 @@ inode_create (block_sector_t sector, off_t length)
   bool success = false;
 
   ASSERT (length >= 0);
+  if (length > INODE_MAX_LENGTH)
+    return false;
 
   /* If this assertion fails, the inode structure is not exactly
      one sector in size, and you should fix that. */
@@ -84,22 +313,15 @@ inode_create (block_sector_t sector, off_t length)
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
+      if (inode_allocate (disk_inode, 0, bytes_to_sectors (length), sector)) 
         {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
+          cache_write_at (sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
           success = true; 
         } 
+      else
+        inode_deallocate (disk_inode);
       free (disk_inode);
     }
   return success;
@@ -115,29 +337,44 @@ inode_open (block_sector_t sector)
   struct inode *inode;
 
   /* Check whether this inode is already open. */
+  lock_acquire (&open_inodes_lock);
   for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
        e = list_next (e)) 
     {
       inode = list_entry (e, struct inode, elem);
       if (inode->sector == sector) 
         {
-          inode_reopen (inode);
+          inode->open_cnt++;
+          lock_release (&open_inodes_lock);
           return inode; 
         }
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
-  /* Initialize. */
+  /* Initialize.  Publish the inode locked, then read it in with
+     open_inodes_lock released, so that opening other inodes does
+     not wait for the disk.  Anyone else who opens this inode
+     meanwhile waits on RW before using it. */
   list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  inode->read_end = 0;
+  rwlock_init (&inode->rw);
+  lock_init (&inode->lock);
+  rwlock_acquire_write (&inode->rw);
+  lock_release (&open_inodes_lock);
+
+  cache_read_at (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+  rwlock_release_write (&inode->rw);
   return inode;
 }
 
@@ -146,7 +383,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -163,25 +404,31 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode) 
 {
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
+  /* Remove from inode list if this was the last opener.  No one
+     else can find INODE after that, so the rest needs no lock. */
+  lock_acquire (&open_inodes_lock);
+  last = --inode->open_cnt == 0;
+  if (last)
+    list_remove (&inode->elem);
+  lock_release (&open_inodes_lock);
+
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          inode_deallocate (&inode->data);
         }
 
-      free (inode); 
+      kmem_cache_free (inode_cache, inode); 
     }
 }
 
@@ -191,19 +438,42 @@ void
 inode_remove (struct inode *inode) 
 {
   ASSERT (inode != NULL);
+  lock_acquire (&open_inodes_lock);
   inode->removed = true;
+  lock_release (&open_inodes_lock);
+}
+
+/* Acquires INODE's lock, which the file system itself never
+   takes.  The directory layer holds it across a lookup and the
+   change that depends on it, so that two threads adding or
+   removing entries in one directory cannot interleave, while
+   other directories and plain reads of this one go on. */
+void
+inode_lock (struct inode *inode) 
+{
+  lock_acquire (&inode->lock);
+}
+
+/* Releases INODE's lock, acquired with inode_lock(). */
+void
+inode_unlock (struct inode *inode) 
+{
+  lock_release (&inode->lock);
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
-   than SIZE if an error occurs or end of file is reached. */
+   than SIZE if an error occurs or end of file is reached.
+   If this read picks up where the last one left off, the sector
+   following it is read ahead in the background. */
 off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
+  bool sequential = offset == inode->read_end;
 
+  rwlock_acquire_read (&inode->rw);
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
@@ -211,7 +481,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      off_t inode_left = inode->data.length - offset;
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
@@ -220,99 +490,98 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+      if (sector_idx != NO_SECTOR)
+        cache_read_at (sector_idx, buffer + bytes_read,
+                       sector_ofs, chunk_size);
+      else
+        memset (buffer + bytes_read, 0, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
+  inode->read_end = offset;
+
+  if (sequential && bytes_read > 0)
+    {
+      off_t next = ROUND_UP (offset, BLOCK_SECTOR_SIZE);
+      if (next < inode->data.length)
+        {
+          block_sector_t next_sector = byte_to_sector (inode, next);
+          if (next_sector != NO_SECTOR)
+            cache_read_ahead (next_sector);
+        }
+    }
+  rwlock_release_read (&inode->rw);
 
   return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk fills up, the maximum file size is
+   reached, or an error occurs.
+   A write past end of file extends the inode.  Any sectors
+   between the old end of file and OFFSET are left as holes,
+   which read as zeros until they are written. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  bool disk_changed = false;
 
-  if (inode->deny_write_cnt)
-    return 0;
+  rwlock_acquire_write (&inode->rw);
+  if (inode->deny_write_cnt || offset >= INODE_MAX_LENGTH)
+    {
+      rwlock_release_write (&inode->rw);
+      return 0;
+    }
+  if (size > INODE_MAX_LENGTH - offset)
+    size = INODE_MAX_LENGTH - offset;
 
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      size_t sector_pos = offset / BLOCK_SECTOR_SIZE;
+      block_sector_t sector_idx = index_lookup (&inode->data, sector_pos);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
-      int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
-
       /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
-        break;
+      int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
+      int chunk_size = size < sector_left ? size : sector_left;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+      if (sector_idx == NO_SECTOR)
         {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
+          /* Fill in this hole, and any others that the rest of the
+             write covers, in as few extents as possible. */
+          inode_allocate (&inode->data, sector_pos,
+                          bytes_to_sectors (offset + size), inode->sector);
+          disk_changed = true;
+          sector_idx = index_lookup (&inode->data, sector_pos);
+          if (sector_idx == NO_SECTOR)
+            break;
         }
-      else 
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
 
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
-        }
+      cache_write_at (sector_idx, buffer + bytes_written,
+                      sector_ofs, chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
+
+  if (offset > inode->data.length)
+    {
+      inode->data.length = offset;
+      disk_changed = true;
+    }
+  if (disk_changed)
+    cache_write_at (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+  rwlock_release_write (&inode->rw);
 
   return bytes_written;
 }
@@ -322,8 +591,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 void
 inode_deny_write (struct inode *inode) 
 {
+  rwlock_acquire_write (&inode->rw);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  rwlock_release_write (&inode->rw);
 }
 
 /* Re-enables writes to INODE.
@@ -332,14 +603,21 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  rwlock_acquire_write (&inode->rw);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  rwlock_release_write (&inode->rw);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
 off_t
-inode_length (const struct inode *inode)
+inode_length (struct inode *inode)
 {
-  return inode->data.length;
+  off_t length;
+
+  rwlock_acquire_read (&inode->rw);
+  length = inode->data.length;
+  rwlock_release_read (&inode->rw);
+  return length;
 }
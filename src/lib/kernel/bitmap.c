@@ -69,6 +69,42 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns an elem_type in which bits START through END - 1 are
+   turned on, where 0 <= START < END <= ELEM_BITS. */
+static inline elem_type
+range_mask (size_t start, size_t end) 
+{
+  elem_type high = (end < ELEM_BITS
+                    ? ((elem_type) 1 << end) - 1 : (elem_type) -1);
+  return high & ~(((elem_type) 1 << start) - 1);
+}
+
+/* Returns the bits of element IDX of B that are set to VALUE
+   and lie between bit START and bit END of B, exclusive, as an
+   elem_type in which those bits are 1 and all others are 0. */
+static inline elem_type
+matching_bits (const struct bitmap *b, size_t idx, size_t start, size_t end,
+               bool value) 
+{
+  size_t base = idx * ELEM_BITS;
+  size_t lo = start > base ? start - base : 0;
+  size_t hi = end - base < ELEM_BITS ? end - base : ELEM_BITS;
+  elem_type bits = value ? b->bits[idx] : ~b->bits[idx];
+  return bits & range_mask (lo, hi);
+}
+
+/* Returns the number of 1-bits in X, which must be 32 bits wide. */
+static inline size_t
+popcount (elem_type x) 
+{
+  /* Parallel count, which avoids depending on libgcc for
+     __builtin_popcount(). */
+  x = x - ((x >> 1) & 0x55555555);
+  x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+  x = (x + (x >> 4)) & 0x0f0f0f0f;
+  return (x * 0x01010101) >> 24;
+}
+
 /* Creation and destruction. */
 
 /* Creates and returns a pointer to a newly allocated bitmap with room for
@@ -213,18 +249,37 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Each bit is set atomically, as by bitmap_set(), but the group
+   as a whole is not set atomically. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
+  size_t end = start + cnt;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  while (start < end) 
+    {
+      size_t idx = elem_idx (start);
+      size_t ofs = start % ELEM_BITS;
+      size_t n = end - start < ELEM_BITS - ofs ? end - start : ELEM_BITS - ofs;
+      elem_type mask = range_mask (ofs, ofs + n);
+
+      /* Whole elements are stored directly, which is atomic
+         since they are aligned.  Partial elements need the same
+         read-modify-write instructions as bitmap_mark() and
+         bitmap_reset(). */
+      if (mask == (elem_type) -1)
+        b->bits[idx] = value ? mask : 0;
+      else if (value)
+        asm ("orl %1, %0" : "+m" (b->bits[idx]) : "r" (mask) : "cc");
+      else
+        asm ("andl %1, %0" : "+m" (b->bits[idx]) : "r" (~mask) : "cc");
+      start += n;
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -232,16 +287,17 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t end = start + cnt;
+  size_t idx, value_cnt;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
   value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
+  if (cnt > 0)
+    for (idx = elem_idx (start); idx <= elem_idx (end - 1); idx++)
+      value_cnt += popcount (matching_bits (b, idx, start, end, value));
   return value_cnt;
 }
 
@@ -250,15 +306,17 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
+  size_t end = start + cnt;
+  size_t idx;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
+  if (cnt > 0)
+    for (idx = elem_idx (start); idx <= elem_idx (end - 1); idx++)
+      if (matching_bits (b, idx, start, end, value) != 0)
+        return true;
   return false;
 }
 
@@ -291,20 +349,71 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
-   If there is no such group, returns BITMAP_ERROR. */
+   If there is no such group, returns BITMAP_ERROR.
+
+   Works an element at a time: elements with no bits set to
+   VALUE end the current run and elements with all bits set to
+   VALUE extend it, each in a single step, and runs within other
+   elements are measured by counting trailing zeros. */
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
+  size_t run_start = start;     /* Start of current run of VALUE. */
+  size_t run_cnt = 0;           /* Length of current run of VALUE. */
+  size_t idx;
+
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
+  if (cnt > b->bit_cnt)
+    return BITMAP_ERROR;
+  if (cnt == 0)
+    return start;
+
+  for (idx = elem_idx (start); idx < elem_cnt (b->bit_cnt); idx++)
     {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      elem_type bits = matching_bits (b, idx, start, b->bit_cnt, value);
+      size_t bit = 0;
+
+      if (bits == (elem_type) -1)
+        {
+          if (run_cnt == 0)
+            run_start = idx * ELEM_BITS;
+          run_cnt += ELEM_BITS;
+          if (run_cnt >= cnt)
+            return run_start;
+          continue;
+        }
+
+      while (bit < ELEM_BITS)
+        {
+          elem_type rest = bits >> bit;
+          size_t ones;
+
+          if (rest == 0)
+            {
+              run_cnt = 0;
+              break;
+            }
+          if ((rest & 1) == 0)
+            {
+              /* Skip to the next bit set to VALUE. */
+              run_cnt = 0;
+              bit += __builtin_ctzl (rest);
+              rest = bits >> bit;
+            }
+
+          /* Measure the bits set to VALUE starting here.  ~REST
+             cannot be 0, because BITS is not all ones and the
+             shift brings in zeros. */
+          ones = __builtin_ctzl (~rest);
+          if (run_cnt == 0)
+            run_start = idx * ELEM_BITS + bit;
+          run_cnt += ones;
+          if (run_cnt >= cnt)
+            return run_start;
+          bit += ones;
+        }
     }
   return BITMAP_ERROR;
 }
@@ -358,6 +467,31 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes the part of B that holds the bits between START and
+   START + CNT, exclusive, to the same place in FILE that
+   bitmap_write() would put it, rounded out to whole elements.
+   Returns true if successful, false otherwise. */
+bool
+bitmap_write_range (const struct bitmap *b, struct file *file,
+                    size_t start, size_t cnt)
+{
+  size_t first, last;
+  off_t ofs, size;
+
+  ASSERT (b != NULL);
+  ASSERT (start <= b->bit_cnt);
+  ASSERT (start + cnt <= b->bit_cnt);
+
+  if (cnt == 0)
+    return true;
+
+  first = elem_idx (start);
+  last = elem_idx (start + cnt - 1);
+  ofs = first * sizeof (elem_type);
+  size = (last - first + 1) * sizeof (elem_type);
+  return file_write_at (file, b->bits + first, size, ofs) == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
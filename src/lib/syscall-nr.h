@@ -28,7 +28,12 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Vectored and batched I/O. */
+    SYS_READV,                  /* Read into several buffers. */
+    SYS_WRITEV,                 /* Write from several buffers. */
+    SYS_IO_RING_ENTER           /* Carry out queued file operations. */
   };
 
 #endif /* lib/syscall-nr.h */
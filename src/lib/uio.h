@@ -0,0 +1,70 @@
+#ifndef __LIB_UIO_H
+#define __LIB_UIO_H
+
+#include <stddef.h>
+
+/* Vectored and batched I/O, shared by user programs and the
+   kernel. */
+
+/* One buffer for readv() or writev(). */
+struct iovec
+  {
+    void *iov_base;             /* Start of buffer. */
+    size_t iov_len;             /* Number of bytes in buffer. */
+  };
+
+/* Most buffers that one readv() or writev() may pass. */
+#define IOV_MAX 64
+
+/* I/O ring.
+
+   A process submits file operations by filling in entries of SQ
+   (the submission queue) and advancing SQ_TAIL, then passes the
+   ring to io_ring_enter().  The kernel carries out the submitted
+   operations in order, posting the result of each to CQ (the
+   completion queue) and advancing SQ_HEAD and CQ_TAIL as it
+   goes, then returns.  The process reaps completions from CQ_HEAD
+   up to CQ_TAIL and advances CQ_HEAD past them.
+
+   The head and tail counters run freely; the entry for counter
+   value N is at index N % IO_RING_SIZE.  The kernel only writes
+   SQ_HEAD, CQ_TAIL, and CQ, and stops early if CQ fills up. */
+#define IO_RING_SIZE 32
+
+/* Operations. */
+enum io_op
+  {
+    IO_READ,                    /* read() into BUF. */
+    IO_WRITE                    /* write() from BUF. */
+  };
+
+/* A submission queue entry. */
+struct io_sqe
+  {
+    int op;                     /* An enum io_op. */
+    int fd;                     /* File descriptor. */
+    void *buf;                  /* Buffer. */
+    unsigned len;               /* Number of bytes. */
+    int ofs;                    /* File offset, or -1 for the file's
+                                   position, which is advanced. */
+    unsigned user_data;         /* Copied to the completion. */
+  };
+
+/* A completion queue entry. */
+struct io_cqe
+  {
+    unsigned user_data;         /* From the submission. */
+    int result;                 /* Bytes transferred, or -1. */
+  };
+
+struct io_ring
+  {
+    unsigned sq_head;           /* Next submission to carry out. */
+    unsigned sq_tail;           /* Next submission slot to fill. */
+    unsigned cq_head;           /* Next completion to reap. */
+    unsigned cq_tail;           /* Next completion slot to fill. */
+    struct io_sqe sq[IO_RING_SIZE]; /* Submission queue. */
+    struct io_cqe cq[IO_RING_SIZE]; /* Completion queue. */
+  };
+
+#endif /* lib/uio.h */
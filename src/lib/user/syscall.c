@@ -1,9 +1,75 @@
 #include <syscall.h>
+#include <stdint.h>
 #include "../syscall-nr.h"
 
+/* System calls enter the kernel with SYSENTER if the CPU has it,
+   passing the call number and arguments in registers, and
+   otherwise with `int $0x30', passing them on the stack.  The
+   kernel accepts either. */
+
+static bool cpu_has_sysenter (void);
+
+/* 1 if system calls use SYSENTER, 0 if they use `int $0x30', -1
+   if not yet decided. */
+static int sysenter_state = -1;
+
+/* Returns true if system calls should use SYSENTER. */
+static inline bool
+use_sysenter (void)
+{
+  if (sysenter_state < 0)
+    sysenter_state = cpu_has_sysenter ();
+  return sysenter_state;
+}
+
+/* Invokes syscall NUMBER with SYSENTER, passing arguments ARG0,
+   ARG1, and ARG2 in %ebx, %esi, and %edi, and returns the return
+   value as an `int'.  The kernel returns with SYSEXIT to the
+   address in %edx, with the stack pointer in %ecx. */
+static inline int
+sysenter_syscall (int number, uint32_t arg0, uint32_t arg1, uint32_t arg2)
+{
+  int retval;
+  asm volatile ("movl %%esp, %%ecx; movl $1f, %%edx; sysenter; 1:"
+                : "=a" (retval)
+                : "a" (number), "b" (arg0), "S" (arg1), "D" (arg2)
+                : "ecx", "edx", "memory");
+  return retval;
+}
+
 /* Invokes syscall NUMBER, passing no arguments, and returns the
    return value as an `int'. */
 #define syscall0(NUMBER)                                        \
+        (use_sysenter ()                                        \
+         ? sysenter_syscall (NUMBER, 0, 0, 0)                   \
+         : int_syscall0 (NUMBER))
+
+/* Invokes syscall NUMBER, passing argument ARG0, and returns the
+   return value as an `int'. */
+#define syscall1(NUMBER, ARG0)                                  \
+        (use_sysenter ()                                        \
+         ? sysenter_syscall (NUMBER, (uint32_t) (ARG0), 0, 0)   \
+         : int_syscall1 (NUMBER, ARG0))
+
+/* Invokes syscall NUMBER, passing arguments ARG0 and ARG1, and
+   returns the return value as an `int'. */
+#define syscall2(NUMBER, ARG0, ARG1)                            \
+        (use_sysenter ()                                        \
+         ? sysenter_syscall (NUMBER, (uint32_t) (ARG0),         \
+                             (uint32_t) (ARG1), 0)              \
+         : int_syscall2 (NUMBER, ARG0, ARG1))
+
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, and
+   ARG2, and returns the return value as an `int'. */
+#define syscall3(NUMBER, ARG0, ARG1, ARG2)                      \
+        (use_sysenter ()                                        \
+         ? sysenter_syscall (NUMBER, (uint32_t) (ARG0),         \
+                             (uint32_t) (ARG1), (uint32_t) (ARG2)) \
+         : int_syscall3 (NUMBER, ARG0, ARG1, ARG2))
+
+/* Invokes syscall NUMBER with `int $0x30', passing no arguments,
+   and returns the return value as an `int'. */
+#define int_syscall0(NUMBER)                                        \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
@@ -14,9 +80,9 @@
           retval;                                               \
         })
 
-/* Invokes syscall NUMBER, passing argument ARG0, and returns the
-   return value as an `int'. */
-#define syscall1(NUMBER, ARG0)                                           \
+/* Invokes syscall NUMBER with `int $0x30', passing argument
+   ARG0, and returns the return value as an `int'. */
+#define int_syscall1(NUMBER, ARG0)                                           \
         ({                                                               \
           int retval;                                                    \
           asm volatile                                                   \
@@ -28,9 +94,9 @@
           retval;                                                        \
         })
 
-/* Invokes syscall NUMBER, passing arguments ARG0 and ARG1, and
-   returns the return value as an `int'. */
-#define syscall2(NUMBER, ARG0, ARG1)                            \
+/* Invokes syscall NUMBER with `int $0x30', passing arguments
+   ARG0 and ARG1, and returns the return value as an `int'. */
+#define int_syscall2(NUMBER, ARG0, ARG1)                            \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
@@ -44,9 +110,10 @@
           retval;                                               \
         })
 
-/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, and
-   ARG2, and returns the return value as an `int'. */
-#define syscall3(NUMBER, ARG0, ARG1, ARG2)                      \
+/* Invokes syscall NUMBER with `int $0x30', passing arguments
+   ARG0, ARG1, and ARG2, and returns the return value as an
+   `int'. */
+#define int_syscall3(NUMBER, ARG0, ARG1, ARG2)                      \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
@@ -61,6 +128,34 @@
           retval;                                               \
         })
 
+/* Returns true if the CPU supports SYSENTER and SYSEXIT.  Early
+   Pentium Pro processors claim to but do not. */
+static bool
+cpu_has_sysenter (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  unsigned family, model, stepping;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+  return ((edx & (1 << 11)) != 0
+          && !(family == 6 && model < 3 && stepping < 3));
+}
+
+/* Makes later system calls enter the kernel through ENTRY.
+   Returns true if successful, false if ENTRY is SYSCALL_SYSENTER
+   and the CPU does not support it. */
+bool
+syscall_set_entry (enum syscall_entry entry)
+{
+  if (entry == SYSCALL_SYSENTER && !cpu_has_sysenter ())
+    return false;
+  sysenter_state = entry == SYSCALL_SYSENTER;
+  return true;
+}
+
 void
 halt (void) 
 {
@@ -182,3 +277,21 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+io_ring_enter (struct io_ring *ring)
+{
+  return syscall1 (SYS_IO_RING_ENTER, ring);
+}
@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <uio.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +46,18 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Vectored and batched I/O.  See lib/uio.h. */
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+int io_ring_enter (struct io_ring *);
+
+/* How system calls enter the kernel.  SYSCALL_SYSENTER is the
+   default if the CPU supports it. */
+enum syscall_entry
+  {
+    SYSCALL_INT,                /* `int $0x30', always available. */
+    SYSCALL_SYSENTER            /* SYSENTER, faster. */
+  };
+bool syscall_set_entry (enum syscall_entry);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,42 @@
+/* Child process for par-read test.
+   Reads its own test file in 4 kB blocks and checks each one. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/par-read.h"
+
+static char expected[FILE_SIZE];
+static char block[BLOCK_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  char name[16];
+  int child_idx;
+  int fd;
+  size_t ofs;
+
+  test_name = "child-par-read";
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+  par_read_file_name (name, child_idx);
+
+  random_init (child_idx);
+  random_bytes (expected, sizeof expected);
+
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  for (ofs = 0; ofs < sizeof expected; ofs += sizeof block)
+    {
+      CHECK (read (fd, block, sizeof block) == (int) sizeof block,
+             "read \"%s\"", name);
+      compare_bytes (block, expected + ofs, sizeof block, ofs, name);
+    }
+  close (fd);
+
+  return child_idx;
+}
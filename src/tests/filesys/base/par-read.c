@@ -0,0 +1,59 @@
+/* Spawns 4 child processes, each of which reads a different file
+   in 4 kB blocks and checks its contents, and reports how long
+   they take together.  Reads of different files should overlap,
+   with one child copying data out of the buffer cache while
+   another waits for the disk, so the time per kB should be well
+   below what reading the files one after another takes. */
+
+#include <random.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/base/par-read.h"
+
+static char buf[FILE_SIZE];
+
+/* Reads the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  uint64_t start, cycles;
+  int i;
+
+  msg ("create %d files of %d bytes", CHILD_CNT, FILE_SIZE);
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      char name[16];
+      int fd;
+
+      par_read_file_name (name, i);
+      random_init (i);
+      random_bytes (buf, sizeof buf);
+      if (!create (name, sizeof buf))
+        fail ("create \"%s\" failed", name);
+      fd = open (name);
+      if (fd < 2)
+        fail ("open \"%s\" failed", name);
+      if (write (fd, buf, sizeof buf) != (int) sizeof buf)
+        fail ("write \"%s\" failed", name);
+      close (fd);
+    }
+
+  start = rdtsc ();
+  exec_children ("child-par-read", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+  cycles = rdtsc () - start;
+
+  msg ("throughput: %u cycles per kB",
+       (unsigned) (cycles / (CHILD_CNT * FILE_SIZE / 1024)));
+}
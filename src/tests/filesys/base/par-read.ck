@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = grep (!/^\(par-read\) throughput: \d+ cycles per kB$/, @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(par-read) begin
+(par-read) create 4 files of 32768 bytes
+(par-read) exec child 1 of 4: "child-par-read 0"
+(par-read) exec child 2 of 4: "child-par-read 1"
+(par-read) exec child 3 of 4: "child-par-read 2"
+(par-read) exec child 4 of 4: "child-par-read 3"
+(par-read) wait for child 1 of 4 returned 0 (expected 0)
+(par-read) wait for child 2 of 4 returned 1 (expected 1)
+(par-read) wait for child 3 of 4 returned 2 (expected 2)
+(par-read) wait for child 4 of 4 returned 3 (expected 3)
+(par-read) end
+EOF
+pass;
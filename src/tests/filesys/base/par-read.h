@@ -0,0 +1,20 @@
+#ifndef TESTS_FILESYS_BASE_PAR_READ_H
+#define TESTS_FILESYS_BASE_PAR_READ_H
+
+#include <stdio.h>
+
+/* Each child reads a file of its own, which together are several
+   times the size of the buffer cache, so that the children spend
+   most of their time waiting for the disk. */
+#define CHILD_CNT 4
+#define FILE_SIZE (32 * 1024)
+#define BLOCK_SIZE 4096
+
+/* Stores the name of child CHILD_IDX's file into NAME. */
+static inline void
+par_read_file_name (char name[16], int child_idx) 
+{
+  snprintf (name, 16, "data%d", child_idx);
+}
+
+#endif /* tests/filesys/base/par-read.h */
@@ -0,0 +1,317 @@
+/* Test program and microbenchmark for lib/string.c.
+
+   Checks memcpy(), memmove(), memset(), memcmp(), memchr(), and
+   strlen() against byte-at-a-time versions at every alignment,
+   then reports the throughput of each, in bytes per 100 CPU
+   cycles, for block sizes from 1 byte to 64 kB, alongside the
+   byte-at-a-time loop it replaced.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/test.h"
+
+/* Largest block size checked and benchmarked. */
+#define MAX_SIZE (64 * 1024)
+
+/* Total number of bytes processed per benchmark measurement,
+   so that small sizes are repeated enough to be measurable. */
+#define BENCH_BYTES (1024 * 1024)
+
+static void verify (void);
+static void benchmark (void);
+
+void
+test (void)
+{
+  verify ();
+  benchmark ();
+}
+
+/* Reads the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Byte-at-a-time reference versions.  Marked noinline and
+   written with volatile pointers so that the compiler cannot
+   turn them back into calls to the functions under test. */
+
+static void __attribute__ ((noinline))
+slow_memcpy (void *dst_, const void *src_, size_t size)
+{
+  volatile unsigned char *dst = dst_;
+  const volatile unsigned char *src = src_;
+
+  while (size-- > 0)
+    *dst++ = *src++;
+}
+
+static void __attribute__ ((noinline))
+slow_memset (void *dst_, int value, size_t size)
+{
+  volatile unsigned char *dst = dst_;
+
+  while (size-- > 0)
+    *dst++ = value;
+}
+
+static int __attribute__ ((noinline))
+slow_memcmp (const void *a_, const void *b_, size_t size)
+{
+  const volatile unsigned char *a = a_;
+  const volatile unsigned char *b = b_;
+
+  for (; size-- > 0; a++, b++)
+    if (*a != *b)
+      return *a > *b ? +1 : -1;
+  return 0;
+}
+
+static const void * __attribute__ ((noinline))
+slow_memchr (const void *block_, int ch, size_t size)
+{
+  const volatile unsigned char *block = block_;
+
+  for (; size-- > 0; block++)
+    if (*block == (unsigned char) ch)
+      return (const void *) block;
+  return NULL;
+}
+
+static size_t __attribute__ ((noinline))
+slow_strlen (const char *string)
+{
+  const volatile char *p;
+
+  for (p = string; *p != '\0'; p++)
+    continue;
+  return p - string;
+}
+
+/* Fills the SIZE bytes at BUF with random nonzero bytes. */
+static void
+fill_random (unsigned char *buf, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    buf[i] = random_ulong () % 255 + 1;
+}
+
+/* Checks each function against its reference version on short
+   blocks at every combination of alignments. */
+static void
+verify (void)
+{
+  enum { SIZE = 256 };
+  unsigned char a[SIZE], b[SIZE], r[SIZE], t[SIZE];
+  int iter;
+
+  printf ("verifying string operations...");
+  for (iter = 0; iter < 20000; iter++)
+    {
+      size_t dst = random_ulong () % (SIZE / 2);
+      size_t src = random_ulong () % (SIZE / 2);
+      size_t size = random_ulong () % (SIZE / 2);
+      int ch = random_ulong () % 256;
+
+      fill_random (a, SIZE);
+      memcpy (b, a, SIZE);
+      slow_memcpy (r, a, SIZE);
+      ASSERT (!slow_memcmp (b, r, SIZE));
+
+      /* memmove() with possibly overlapping blocks. */
+      memmove (b + dst, b + src, size);
+      slow_memcpy (t, a + src, size);
+      slow_memcpy (r + dst, t, size);
+      ASSERT (!slow_memcmp (b, r, SIZE));
+
+      /* memset(). */
+      slow_memcpy (b, a, SIZE);
+      slow_memcpy (r, a, SIZE);
+      memset (b + dst, ch, size);
+      slow_memset (r + dst, ch, size);
+      ASSERT (!slow_memcmp (b, r, SIZE));
+
+      /* memcmp(), with and without a difference. */
+      slow_memcpy (b, a, SIZE);
+      if (size > 0 && ch % 2)
+        b[dst + random_ulong () % size] ^= ch | 1;
+      ASSERT (memcmp (a + dst, b + dst, size)
+              == slow_memcmp (a + dst, b + dst, size));
+
+      /* memchr() for a byte that may or may not be present. */
+      ASSERT (memchr (a + dst, ch, size) == slow_memchr (a + dst, ch, size));
+
+      /* strlen() of a string at any alignment. */
+      a[dst + size] = '\0';
+      ASSERT (strlen ((char *) a + dst) == slow_strlen ((char *) a + dst));
+    }
+  printf ("done\n");
+}
+
+/* Function under measurement: performs one operation on SIZE
+   bytes of DST and SRC. */
+typedef void bench_func (unsigned char *dst, unsigned char *src,
+                         size_t size);
+
+static void
+bench_memcpy (unsigned char *d, unsigned char *s, size_t n)
+{
+  memcpy (d, s, n);
+}
+
+static void
+bench_slow_memcpy (unsigned char *d, unsigned char *s, size_t n)
+{
+  slow_memcpy (d, s, n);
+}
+
+static void
+bench_memmove (unsigned char *d, unsigned char *s UNUSED, size_t n)
+{
+  memmove (d + 1, d, n);
+}
+
+static void
+bench_memset (unsigned char *d, unsigned char *s UNUSED, size_t n)
+{
+  memset (d, 0x5a, n);
+}
+
+static void
+bench_slow_memset (unsigned char *d, unsigned char *s UNUSED, size_t n)
+{
+  slow_memset (d, 0x5a, n);
+}
+
+static void
+bench_memcmp (unsigned char *d, unsigned char *s, size_t n)
+{
+  ASSERT (memcmp (d, s, n) == 0);
+}
+
+static void
+bench_slow_memcmp (unsigned char *d, unsigned char *s, size_t n)
+{
+  ASSERT (slow_memcmp (d, s, n) == 0);
+}
+
+static void
+bench_memchr (unsigned char *d UNUSED, unsigned char *s, size_t n)
+{
+  ASSERT (memchr (s, 0, n) == NULL);
+}
+
+static void
+bench_slow_memchr (unsigned char *d UNUSED, unsigned char *s, size_t n)
+{
+  ASSERT (slow_memchr (s, 0, n) == NULL);
+}
+
+static void
+bench_strlen (unsigned char *d UNUSED, unsigned char *s, size_t n)
+{
+  ASSERT (strlen ((char *) s) == n);
+}
+
+static void
+bench_slow_strlen (unsigned char *d UNUSED, unsigned char *s, size_t n)
+{
+  ASSERT (slow_strlen ((char *) s) == n);
+}
+
+/* A function to benchmark and the byte-at-a-time loop it
+   replaced.  memmove() is compared against the forward byte
+   copy that it used for non-overlapping blocks. */
+struct bench
+  {
+    const char *name;
+    bench_func *fast;
+    bench_func *slow;
+    bool is_string;             /* Needs a null-terminated SRC? */
+  };
+
+static const struct bench benches[] =
+  {
+    {"memcpy", bench_memcpy, bench_slow_memcpy, false},
+    {"memmove", bench_memmove, bench_slow_memcpy, false},
+    {"memset", bench_memset, bench_slow_memset, false},
+    {"memcmp", bench_memcmp, bench_slow_memcmp, false},
+    {"memchr", bench_memchr, bench_slow_memchr, false},
+    {"strlen", bench_strlen, bench_slow_strlen, true},
+  };
+
+/* Returns the throughput of F on blocks of SIZE bytes, in bytes
+   per 100 cycles.  DST starts out as a copy of SRC each time,
+   since some of the functions modify it. */
+static unsigned
+measure (bench_func *f, unsigned char *dst, unsigned char *src, size_t size)
+{
+  size_t reps = BENCH_BYTES / size;
+  uint64_t start, cycles;
+  size_t i;
+
+  memcpy (dst, src, size + 1);
+  f (dst, src, size);           /* Warm the cache. */
+  start = rdtsc ();
+  for (i = 0; i < reps; i++)
+    f (dst, src, size);
+  cycles = rdtsc () - start;
+  return cycles > 0 ? (uint64_t) reps * size * 100 / cycles : 0;
+}
+
+/* Reports throughput at each power-of-2 size up to MAX_SIZE. */
+static void
+benchmark (void)
+{
+  unsigned char *dst = malloc (MAX_SIZE + 1);
+  unsigned char *src = malloc (MAX_SIZE + 1);
+  size_t size, i;
+
+  ASSERT (dst != NULL && src != NULL);
+  fill_random (src, MAX_SIZE + 1);
+
+  printf ("bytes per 100 cycles, new/old:\n");
+  printf ("%8s", "size");
+  for (i = 0; i < sizeof benches / sizeof *benches; i++)
+    printf (" %15s", benches[i].name);
+  printf ("\n");
+
+  for (size = 1; size <= MAX_SIZE; size *= 2)
+    {
+      printf ("%8zu", size);
+      for (i = 0; i < sizeof benches / sizeof *benches; i++)
+        {
+          const struct bench *b = &benches[i];
+          unsigned fast, slow;
+
+          if (b->is_string)
+            src[size] = '\0';
+          fast = measure (b->fast, dst, src, size);
+          slow = measure (b->slow, dst, src, size);
+          if (b->is_string)
+            src[size] = random_ulong () % 255 + 1;
+          printf (" %7u/%-7u", fast, slow);
+        }
+      printf ("\n");
+    }
+
+  free (src);
+  free (dst);
+}
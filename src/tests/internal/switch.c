@@ -0,0 +1,151 @@
+/* Context switch microbenchmark.
+
+   Two threads at the same priority ping-pong with thread_yield().
+   After each switch, the thread that was switched to reads one
+   word from each page of a kernel buffer, so that a switch that
+   flushes the TLB is charged for refilling it.  Reports the CPU
+   cycles per switch when the threads are kernel threads, and,
+   in a kernel built with USERPROG, when they share one page
+   directory and when each has its own.
+
+   Kernel threads and threads that share a page directory should
+   not reload CR3 at all.  Threads with different page
+   directories must reload it, but the kernel's mappings are
+   global, so the buffer's TLB entries should survive anyway.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/test.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef USERPROG
+#include "userprog/pagedir.h"
+#endif
+
+/* Number of round trips per measurement.  Each round trip is two
+   switches. */
+#define ROUND_TRIPS 10000
+
+/* Number of pages of kernel memory touched after each switch. */
+#define WORK_PAGES 64
+
+/* Pages touched after each switch. */
+static uint8_t *work;
+
+/* Page directory for the partner thread to run on, a flag
+   telling it to stop, and a semaphore it ups once it has. */
+static uint32_t *partner_pd;
+static volatile bool partner_done;
+static struct semaphore partner_stopped;
+
+static void measure (const char *name, uint32_t *pd, uint32_t *other_pd);
+static thread_func partner_thread;
+
+void
+test (void)
+{
+  work = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, WORK_PAGES);
+
+  printf ("cycles per switch, touching %d kernel pages:\n", WORK_PAGES);
+  measure ("kernel threads", NULL, NULL);
+#ifdef USERPROG
+  {
+    uint32_t *a = pagedir_create ();
+    uint32_t *b = pagedir_create ();
+
+    ASSERT (a != NULL && b != NULL);
+    measure ("same page directory", a, a);
+    measure ("different page directories", a, b);
+    pagedir_destroy (a);
+    pagedir_destroy (b);
+  }
+#endif
+
+  palloc_free_multiple (work, WORK_PAGES);
+}
+
+/* Reads the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Reads a word from each page of WORK. */
+static void
+touch_work (void)
+{
+  size_t i;
+
+  for (i = 0; i < WORK_PAGES; i++)
+    (void) *(volatile uint32_t *) (work + i * PGSIZE);
+}
+
+/* Runs on page directory PD, or on none if PD is null, until
+   the next switch. */
+static void
+use_pagedir (uint32_t *pd)
+{
+#ifdef USERPROG
+  thread_current ()->pagedir = pd;
+  pagedir_activate (pd);
+#else
+  ASSERT (pd == NULL);
+#endif
+}
+
+/* Times ROUND_TRIPS round trips between this thread, running on
+   page directory PD, and a partner running on OTHER_PD, and
+   prints the cycles per switch under NAME. */
+static void
+measure (const char *name, uint32_t *pd, uint32_t *other_pd)
+{
+  uint64_t start, cycles;
+  int i;
+
+  partner_pd = other_pd;
+  partner_done = false;
+  sema_init (&partner_stopped, 0);
+  use_pagedir (pd);
+  thread_create ("partner", thread_get_priority (), partner_thread, NULL);
+
+  touch_work ();
+  start = rdtsc ();
+  for (i = 0; i < ROUND_TRIPS; i++)
+    {
+      thread_yield ();
+      touch_work ();
+    }
+  cycles = rdtsc () - start;
+
+  /* Wait for the partner to get off its page directory. */
+  partner_done = true;
+  sema_down (&partner_stopped);
+  use_pagedir (NULL);
+
+  printf ("%28s: %"PRIu64"\n", name, cycles / (2 * ROUND_TRIPS));
+}
+
+static void
+partner_thread (void *aux UNUSED)
+{
+  use_pagedir (partner_pd);
+  while (!partner_done)
+    {
+      thread_yield ();
+      touch_work ();
+    }
+  use_pagedir (NULL);
+  sema_up (&partner_stopped);
+}
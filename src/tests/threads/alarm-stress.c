@@ -0,0 +1,90 @@
+/* Puts 1,000 threads to sleep several times each with random
+   deadlines, checks that none of them wakes up early, and
+   reports the longest time that interrupts were kept off to
+   manage the sleeping threads.
+
+   1,000 threads do not fit in the kernel pool with the default
+   4 MB of RAM, so this test runs with more memory. */
+
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 1000         /* Number of sleeping threads. */
+#define ITER_CNT 3              /* Sleeps per thread. */
+#define MAX_SLEEP 200           /* Longest sleep, in ticks. */
+
+/* Information about one sleeping thread. */
+struct sleeper 
+  {
+    int durations[ITER_CNT];    /* Ticks to sleep in each iteration. */
+    struct semaphore *done;     /* Upped when the thread finishes. */
+  };
+
+static thread_func sleeper_thread;
+
+void
+test_alarm_stress (void) 
+{
+  struct sleeper *sleepers;
+  struct semaphore done;
+  uint64_t sleep_cycles, wake_cycles;
+  int i, j;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sleepers = malloc (sizeof *sleepers * THREAD_CNT);
+  if (sleepers == NULL)
+    fail ("couldn't allocate memory for test");
+  sema_init (&done, 0);
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      for (j = 0; j < ITER_CNT; j++)
+        sleepers[i].durations[j] = random_ulong () % MAX_SLEEP + 1;
+      sleepers[i].done = &done;
+    }
+
+  msg ("Creating %d threads to sleep %d times each.", THREAD_CNT, ITER_CNT);
+  timer_sleep_stats (&sleep_cycles, &wake_cycles);
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleep %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper_thread, &sleepers[i])
+          == TID_ERROR)
+        fail ("could not create thread %d", i);
+    }
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  timer_sleep_stats (&sleep_cycles, &wake_cycles);
+  msg ("All threads woke up on time.");
+  msg ("Longest interrupts-off time: %"PRIu64" cycles to sleep, "
+       "%"PRIu64" cycles to wake.", sleep_cycles, wake_cycles);
+
+  free (sleepers);
+}
+
+static void
+sleeper_thread (void *sleeper_) 
+{
+  struct sleeper *sleeper = sleeper_;
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++) 
+    {
+      int64_t start = timer_ticks ();
+      timer_sleep (sleeper->durations[i]);
+      if (timer_elapsed (start) < sleeper->durations[i])
+        fail ("thread woke up after %"PRId64" ticks, not %d",
+              timer_elapsed (start), sleeper->durations[i]);
+    }
+  sema_up (sleeper->done);
+}
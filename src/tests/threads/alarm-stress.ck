@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+fail "Not all threads woke up on time.\n"
+  if !grep (/All threads woke up on time\./, @output);
+fail "Interrupts-off time was not reported.\n"
+  if !grep (/Longest interrupts-off time: \d+ cycles to sleep, \d+ cycles to wake\./,
+	    @output);
+pass;
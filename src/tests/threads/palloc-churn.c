@@ -0,0 +1,101 @@
+/* Churns the kernel page pool with a random mix of 1- to
+   64-page allocations and frees, reporting how long they took
+   and how many failed.  Afterward, checks that freeing
+   everything coalesced the pool back together: as many 64-page
+   blocks must be available as before the churn. */
+
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "devices/timer.h"
+
+/* Number of allocations that may be live at once. */
+#define SLOT_CNT 32
+
+/* Number of allocations and frees. */
+#define OP_CNT 20000
+
+/* Size of the blocks counted before and after the churn. */
+#define BIG_PAGES 64
+
+/* Most BIG_PAGES blocks that count_big_blocks() can hold. */
+#define MAX_BIG_BLOCKS 256
+
+static int count_big_blocks (void);
+
+void
+test_palloc_churn (void) 
+{
+  struct
+    {
+      void *pages;
+      size_t page_cnt;
+    }
+  slots[SLOT_CNT];
+  int before, after, fail_cnt;
+  int64_t start, elapsed;
+  int i;
+
+  before = count_big_blocks ();
+
+  for (i = 0; i < SLOT_CNT; i++)
+    slots[i].pages = NULL;
+
+  fail_cnt = 0;
+  start = timer_usecs ();
+  for (i = 0; i < OP_CNT; i++) 
+    {
+      int slot = random_ulong () % SLOT_CNT;
+
+      if (slots[slot].pages != NULL) 
+        {
+          palloc_free_multiple (slots[slot].pages, slots[slot].page_cnt);
+          slots[slot].pages = NULL;
+        }
+      else 
+        {
+          /* Mostly small allocations, with some large ones. */
+          size_t max = random_ulong () % 4 == 0 ? BIG_PAGES : 8;
+          size_t page_cnt = 1 + random_ulong () % max;
+
+          slots[slot].pages = palloc_get_multiple (0, page_cnt);
+          slots[slot].page_cnt = page_cnt;
+          if (slots[slot].pages == NULL)
+            fail_cnt++;
+        }
+    }
+  elapsed = timer_usecs_elapsed (start);
+
+  for (i = 0; i < SLOT_CNT; i++)
+    if (slots[i].pages != NULL)
+      palloc_free_multiple (slots[i].pages, slots[i].page_cnt);
+
+  after = count_big_blocks ();
+
+  msg ("%d allocations and frees in %"PRId64" us, %d failed.",
+       OP_CNT, elapsed, fail_cnt);
+  msg ("%d-page blocks available before churn: %d, after: %d.",
+       BIG_PAGES, before, after);
+}
+
+/* Returns the number of BIG_PAGES-page blocks that can be
+   allocated from the kernel pool at once, freeing them again
+   before returning. */
+static int
+count_big_blocks (void) 
+{
+  static void *blocks[MAX_BIG_BLOCKS];
+  int cnt, i;
+
+  for (cnt = 0; cnt < MAX_BIG_BLOCKS; cnt++) 
+    {
+      blocks[cnt] = palloc_get_multiple (0, BIG_PAGES);
+      if (blocks[cnt] == NULL)
+        break;
+    }
+  for (i = 0; i < cnt; i++)
+    palloc_free_multiple (blocks[i], BIG_PAGES);
+  return cnt;
+}
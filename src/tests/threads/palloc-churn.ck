@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+local ($_);
+my ($before, $after);
+foreach (@output) {
+    ($before, $after) = /blocks available before churn: (\d+), after: (\d+)/
+      or next;
+}
+
+fail "Missing block counts.\n" if !defined $after;
+fail "No 64-page blocks available before churn.\n" if $before == 0;
+fail "Pool did not coalesce: $before 64-page blocks before churn, "
+  . "$after after.\n"
+  if $after != $before;
+pass;
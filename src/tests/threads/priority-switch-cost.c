@@ -0,0 +1,97 @@
+/* Measures the cost of a context switch as the number of ready
+   threads grows.  For each of 10, 100, and 500 ready threads,
+   two threads at the default priority ping-pong with
+   thread_yield() while the other threads sit in the ready queue
+   at a lower priority.  The number of timer ticks needed for a
+   fixed number of switches is reported; with a constant-time
+   ready queue it should not depend on the number of waiting
+   threads.
+
+   500 threads do not fit in the kernel pool with the default 4
+   MB of RAM, so this test runs with more memory. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of round trips between the two yielding threads in
+   each measurement.  Each round trip is two switches. */
+#define ROUND_TRIPS 10000
+
+static thread_func filler_thread;
+static thread_func partner_thread;
+
+static int64_t measure_switches (int ready_cnt);
+
+/* Tells the partner thread to stop yielding. */
+static volatile bool partner_done;
+
+void
+test_priority_switch_cost (void) 
+{
+  static const int ready_cnts[] = {10, 100, 500};
+  size_t i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  for (i = 0; i < sizeof ready_cnts / sizeof *ready_cnts; i++)
+    {
+      int64_t elapsed = measure_switches (ready_cnts[i]);
+      msg ("%d ready threads: %"PRId64" ticks per %d switches.",
+           ready_cnts[i], elapsed, 2 * ROUND_TRIPS);
+    }
+}
+
+/* Starts READY_CNT filler threads that stay in the ready queue,
+   then times ROUND_TRIPS round trips between this thread and a
+   partner at the same priority.  Returns the elapsed ticks. */
+static int64_t
+measure_switches (int ready_cnt) 
+{
+  int64_t start, elapsed;
+  int i;
+
+  for (i = 0; i < ready_cnt; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "fill %d", i);
+      if (thread_create (name, PRI_DEFAULT - 1, filler_thread, NULL)
+          == TID_ERROR)
+        fail ("could not create filler thread %d", i);
+    }
+
+  partner_done = false;
+  thread_create ("partner", PRI_DEFAULT, partner_thread, NULL);
+
+  start = timer_ticks ();
+  for (i = 0; i < ROUND_TRIPS; i++)
+    thread_yield ();
+  elapsed = timer_elapsed (start);
+
+  /* Let the partner and then all the fillers exit. */
+  partner_done = true;
+  thread_set_priority (PRI_MIN);
+  thread_set_priority (PRI_DEFAULT);
+
+  return elapsed;
+}
+
+static void
+filler_thread (void *aux UNUSED) 
+{
+}
+
+static void
+partner_thread (void *aux UNUSED) 
+{
+  while (!partner_done)
+    thread_yield ();
+}
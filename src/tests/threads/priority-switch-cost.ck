@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+# Collect ticks for each number of ready threads.
+local ($_);
+my (%ticks);
+foreach (@output) {
+    my ($cnt, $ticks) = /(\d+) ready threads: (\d+) ticks per/ or next;
+    $ticks{$cnt} = $ticks;
+}
+
+foreach my $cnt (10, 100, 500) {
+    fail "Missing measurement for $cnt ready threads.\n"
+      if !defined $ticks{$cnt};
+}
+
+# Timing under a simulator is noisy, so only flag a clear trend.
+fail "Switch cost grows with the number of ready threads: "
+  . "$ticks{10} ticks with 10, $ticks{500} ticks with 500.\n"
+  if $ticks{500} > 3 * $ticks{10} + 10;
+pass;
@@ -0,0 +1,83 @@
+/* Reads "sample.txt" through an I/O ring in 64-byte pieces at
+   explicit offsets, submitted last piece first, along with one
+   read from a bad file descriptor.  Checks that every submission
+   completes in order with the right result and that the pieces
+   put together match the file. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PIECE 64
+
+/* Returns the size of piece number PIECE_IDX of SIZE bytes. */
+static unsigned
+piece_size (size_t size, int piece_idx)
+{
+  size_t ofs = piece_idx * PIECE;
+  return size - ofs < PIECE ? size - ofs : PIECE;
+}
+
+static struct io_ring ring;
+static char buf[sizeof sample];
+
+/* Queues a read of LEN bytes at offset OFS in FD into BUF. */
+static void
+submit_read (int fd, void *buf, unsigned len, int ofs, unsigned user_data)
+{
+  struct io_sqe *sqe = &ring.sq[ring.sq_tail % IO_RING_SIZE];
+
+  sqe->op = IO_READ;
+  sqe->fd = fd;
+  sqe->buf = buf;
+  sqe->len = len;
+  sqe->ofs = ofs;
+  sqe->user_data = user_data;
+  ring.sq_tail++;
+}
+
+void
+test_main (void) 
+{
+  size_t size = sizeof sample - 1;
+  int piece_cnt = (size + PIECE - 1) / PIECE;
+  int handle, cnt, i;
+
+  CHECK (piece_cnt < IO_RING_SIZE, "sample fits in ring");
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  for (i = piece_cnt - 1; i >= 0; i--)
+    submit_read (handle, buf + i * PIECE, piece_size (size, i), i * PIECE, i);
+  submit_read (0x20101234, buf, PIECE, 0, piece_cnt);
+
+  cnt = io_ring_enter (&ring);
+  if (cnt != piece_cnt + 1)
+    fail ("io_ring_enter() returned %d instead of %d", cnt, piece_cnt + 1);
+  if (ring.sq_head != ring.sq_tail || ring.cq_tail != (unsigned) cnt)
+    fail ("ring counters not advanced");
+
+  msg ("check completions");
+  for (i = 0; i < cnt; i++)
+    {
+      struct io_cqe *cqe = &ring.cq[ring.cq_head++ % IO_RING_SIZE];
+      int piece = piece_cnt - 1 - i;
+      int expected;
+
+      if (i == piece_cnt)
+        {
+          piece = piece_cnt;
+          expected = -1;
+        }
+      else
+        expected = piece_size (size, piece);
+      if (cqe->user_data != (unsigned) piece)
+        fail ("completion %d is for submission %u, not %d",
+              i, cqe->user_data, piece);
+      if (cqe->result != expected)
+        fail ("completion %d has result %d, not %d",
+              i, cqe->result, expected);
+    }
+  compare_bytes (buf, sample, size, 0, "sample.txt");
+  CHECK (tell (handle) == 0, "file position unchanged");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(io-ring) begin
+(io-ring) sample fits in ring
+(io-ring) open "sample.txt"
+(io-ring) check completions
+(io-ring) file position unchanged
+(io-ring) end
+io-ring: exit(0)
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* Opens "sample.txt" many times, enough to make the kernel's file
+   descriptor table grow several times over.  Each open must
+   return the lowest handle not in use, so handles must come out
+   consecutively, and a closed handle must be the next one
+   reused.  Then reads through one of the handles to make sure it
+   still refers to the file. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OPEN_CNT 1000
+
+static int handles[OPEN_CNT];
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample];
+  int i;
+
+  msg ("open \"sample.txt\" %d times", OPEN_CNT);
+  for (i = 0; i < OPEN_CNT; i++)
+    {
+      handles[i] = open ("sample.txt");
+      if (handles[i] < 2)
+        fail ("open #%d returned %d", i, handles[i]);
+      if (i > 0 && handles[i] != handles[i - 1] + 1)
+        fail ("open #%d returned %d, expected %d",
+              i, handles[i], handles[i - 1] + 1);
+    }
+
+  close (handles[OPEN_CNT / 2]);
+  close (handles[OPEN_CNT / 3]);
+  CHECK (open ("sample.txt") == handles[OPEN_CNT / 3],
+         "lowest closed handle reused first");
+  CHECK (open ("sample.txt") == handles[OPEN_CNT / 2],
+         "next closed handle reused second");
+  CHECK (open ("sample.txt") == handles[OPEN_CNT - 1] + 1,
+         "then handles past the last");
+
+  CHECK (read (handles[OPEN_CNT - 1], buf, sizeof sample - 1)
+         == (int) sizeof sample - 1, "read through last handle");
+  compare_bytes (buf, sample, sizeof sample - 1, 0, "sample.txt");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-many) begin
+(open-many) open "sample.txt" 1000 times
+(open-many) lowest closed handle reused first
+(open-many) next closed handle reused second
+(open-many) then handles past the last
+(open-many) read through last handle
+(open-many) end
+open-many: exit(0)
+EOF
+pass;
@@ -0,0 +1,41 @@
+/* Reads "sample.txt" with readv() into three buffers of uneven
+   size, the last of them larger than what remains of the file,
+   then writes it back out to a new file with writev() and checks
+   the copy. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample + 100];
+  struct iovec iov[3];
+  int handle, byte_cnt;
+
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 10;
+  iov[1].iov_base = buf + 10;
+  iov[1].iov_len = 100;
+  iov[2].iov_base = buf + 110;
+  iov[2].iov_len = sizeof buf - 110;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  byte_cnt = readv (handle, iov, 3);
+  if (byte_cnt != sizeof sample - 1)
+    fail ("readv() returned %d instead of %zu", byte_cnt, sizeof sample - 1);
+  compare_bytes (buf, sample, sizeof sample - 1, 0, "sample.txt");
+  close (handle);
+
+  iov[2].iov_len = sizeof sample - 1 - 110;
+  CHECK (create ("test.txt", sizeof sample - 1), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  byte_cnt = writev (handle, iov, 3);
+  if (byte_cnt != sizeof sample - 1)
+    fail ("writev() returned %d instead of %zu", byte_cnt, sizeof sample - 1);
+  close (handle);
+
+  check_file ("test.txt", sample, sizeof sample - 1);
+}
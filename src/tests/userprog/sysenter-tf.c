@@ -0,0 +1,33 @@
+/* Makes a system call through SYSENTER with the trap flag set.
+   SYSENTER does not clear the flag, so the kernel takes a
+   single-step trap right at its entry point, before it has
+   switched to the thread's kernel stack.  The kernel should
+   shrug that off and carry out the call.
+
+   The trap flag is set by the POPF just before SYSENTER, so no
+   user instruction is single-stepped. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int retval;
+
+  if (!syscall_set_entry (SYSCALL_SYSENTER))
+    {
+      msg ("no SYSENTER");
+      return;
+    }
+
+  asm volatile ("movl %%esp, %%ecx; movl $1f, %%edx; "
+                "pushfl; orl $0x100, (%%esp); popfl; sysenter; 1:"
+                : "=a" (retval)
+                : "a" (SYS_WRITE), "b" (STDOUT_FILENO), "S" (""), "D" (0)
+                : "ecx", "edx", "cc", "memory");
+  CHECK (retval == 0, "write through SYSENTER with trap flag set");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF', <<'EOF']);
+(sysenter-tf) begin
+(sysenter-tf) write through SYSENTER with trap flag set
+(sysenter-tf) end
+sysenter-tf: exit(0)
+EOF
+(sysenter-tf) begin
+(sysenter-tf) no SYSENTER
+(sysenter-tf) end
+sysenter-tf: exit(0)
+EOF
+pass;
@@ -0,0 +1,18 @@
+/* Verifies that memory mappings in kernel memory, above
+   PHYS_BASE, are disallowed. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int handle;
+  
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (handle, (void *) 0xc0000000) == MAP_FAILED,
+         "try to mmap at 0xc0000000");
+  CHECK (mmap (handle, (void *) 0xfffff000) == MAP_FAILED,
+         "try to mmap at 0xfffff000");
+}
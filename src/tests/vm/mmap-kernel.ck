@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-kernel) begin
+(mmap-kernel) open "sample.txt"
+(mmap-kernel) try to mmap at 0xc0000000
+(mmap-kernel) try to mmap at 0xfffff000
+(mmap-kernel) end
+EOF
+pass;
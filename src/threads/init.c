@@ -37,10 +37,21 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/share.h"
+#include "vm/swap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
 
+/* CR4 and CPUID bits for global pages.  See [IA32-v3a] 2.5
+   "Control Registers" and [IA32-v2a] "CPUID". */
+#define CR4_PGE 0x00000080      /* Page Global Enable. */
+#define CPUID_PGE 0x00002000    /* CPUID.1:EDX, global pages supported. */
+
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
@@ -59,6 +70,7 @@ static size_t user_page_limit = SIZE_MAX;
 
 static void bss_init (void);
 static void paging_init (void);
+static bool cpu_has_global_pages (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
@@ -127,6 +139,14 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+#ifdef VM
+  /* Initialize virtual memory. */
+  frame_init ();
+  page_init ();
+  share_init ();
+  swap_init ();
+#endif
+
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -177,7 +197,7 @@ paging_init (void)
           pd[pde_idx] = pde_create (pt);
         }
 
-      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text) | PTE_G;
     }
 
   /* Store the physical address of the page directory into CR3
@@ -186,6 +206,29 @@ paging_init (void)
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
      of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
+
+  /* Every page directory shares the kernel page tables, so the
+     kernel mapping is the same in every address space.  Marking
+     it global keeps its TLB entries across CR3 reloads, so that
+     switching processes only flushes user mappings.  See
+     [IA32-v3a] 3.12 "Translation Lookaside Buffers (TLBs)". */
+  if (cpu_has_global_pages ())
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PGE) : "memory");
+    }
+}
+
+/* Returns true if the CPU supports global pages, according to
+   the CPUID instruction.  Every CPU Pintos runs on has CPUID. */
+static bool
+cpu_has_global_pages (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  return (edx & CPUID_PGE) != 0;
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -256,6 +299,8 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -379,6 +424,7 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -tickless          Stop the timer interrupt while idle.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -225,6 +225,30 @@ intr_yield_on_return (void)
   yield_on_return = true;
 }
 
+/* Returns true if external interrupt VEC_NO has been raised but
+   not yet delivered to the CPU, for instance because interrupts
+   are off. */
+bool
+intr_ext_pending (uint8_t vec_no) 
+{
+  int irq = vec_no - 0x20;
+
+  ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+
+  /* OCW3: make the next read of the control port return the
+     Interrupt Request Register. */
+  if (irq < 8)
+    {
+      outb (PIC0_CTRL, 0x0a);
+      return (inb (PIC0_CTRL) & (1 << irq)) != 0;
+    }
+  else
+    {
+      outb (PIC1_CTRL, 0x0a);
+      return (inb (PIC1_CTRL) & (1 << (irq - 8))) != 0;
+    }
+}
+
 /* 8259A Programmable Interrupt Controller. */
 
 /* Initializes the PICs.  Refer to [8259A] for details.
@@ -7,26 +7,35 @@
 #include <string.h>
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
 
    The size of each request, in bytes, is rounded up to a power
    of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
-
-   Otherwise, a new page of memory, called an "arena", is
-   obtained from the page allocator (if none is available,
-   malloc() returns a null pointer).  The new arena is divided
-   into blocks, all of which are added to the descriptor's free
-   list.  Then we return one of the new blocks.
-
-   When we free a block, we add it to its descriptor's free list.
-   But if the arena that the block was in now has no in-use
-   blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
+   that size.  Each thread keeps a small "magazine" of free
+   blocks for each descriptor.  If the running thread's magazine
+   is nonempty, one of its blocks is used to satisfy the request,
+   without taking any lock: only the owning thread ever touches
+   a magazine.
+
+   Otherwise, the magazine is refilled with a batch of blocks
+   from the descriptor.  The descriptor keeps a list of free
+   blocks, which are used first.  After that, blocks are carved
+   off the descriptor's newest page of memory, called an "arena",
+   one at a time.  When that runs out, a new arena is obtained
+   from the page allocator (if none is available, malloc()
+   returns a null pointer).
+
+   When we free a block, we push it onto the running thread's
+   magazine.  If the magazine is full, half of it is first
+   drained back to the descriptor's free list.  If the arena that
+   a drained block was in now has no in-use blocks, we remove all
+   of the arena's blocks from the free list and give the arena
+   back to the page allocator.  A block in a magazine counts as
+   in use, so a thread returns its magazines to the descriptors
+   when it exits.
 
    We can't handle blocks bigger than 2 kB using this scheme,
    because they're too big to fit in a single page with a
@@ -39,10 +48,18 @@ struct desc
   {
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
+    size_t magazine_size;       /* Most blocks in a thread's magazine. */
     struct list free_list;      /* List of free blocks. */
+    struct arena *bump_arena;   /* Arena that new blocks are carved from. */
     struct lock lock;           /* Lock. */
   };
 
+/* Bytes of free blocks that a thread's magazine may cache for
+   each descriptor, and bounds on the resulting magazine size. */
+#define MAGAZINE_BYTES 1024
+#define MAGAZINE_MIN 2
+#define MAGAZINE_MAX 16
+
 /* Magic number for detecting arena corruption. */
 #define ARENA_MAGIC 0x9a548eed
 
@@ -52,12 +69,17 @@ struct arena
     unsigned magic;             /* Always set to ARENA_MAGIC. */
     struct desc *desc;          /* Owning descriptor, null for big block. */
     size_t free_cnt;            /* Free blocks; pages in big block. */
+    size_t carved_cnt;          /* Blocks ever handed out. */
   };
 
 /* Free block. */
 struct block 
   {
-    struct list_elem free_elem; /* Free list element. */
+    union
+      {
+        struct list_elem free_elem; /* Free list element. */
+        struct block *next;         /* Next block in a magazine. */
+      };
   };
 
 /* Our set of descriptors. */
@@ -66,6 +88,8 @@ static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void refill (struct desc *, struct magazine *);
+static void drain (struct desc *, struct magazine *, size_t cnt);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -79,7 +103,13 @@ malloc_init (void)
       ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+      d->magazine_size = MAGAZINE_BYTES / block_size;
+      if (d->magazine_size < MAGAZINE_MIN)
+        d->magazine_size = MAGAZINE_MIN;
+      if (d->magazine_size > MAGAZINE_MAX)
+        d->magazine_size = MAGAZINE_MAX;
       list_init (&d->free_list);
+      d->bump_arena = NULL;
       lock_init (&d->lock);
     }
 }
@@ -90,6 +120,7 @@ void *
 malloc (size_t size) 
 {
   struct desc *d;
+  struct magazine *m;
   struct block *b;
   struct arena *a;
 
@@ -119,38 +150,140 @@ malloc (size_t size)
       return a + 1;
     }
 
-  lock_acquire (&d->lock);
+  /* Take a block from the running thread's magazine, refilling
+     it from the descriptor if it is empty. */
+  m = &thread_current ()->magazines[d - descs];
+  if (m->cnt == 0)
+    {
+      refill (d, m);
+      if (m->cnt == 0)
+        return NULL;
+    }
+  b = m->top;
+  m->top = b->next;
+  m->cnt--;
+  return b;
+}
+
+/* Takes a free block from descriptor D, carving a new one from
+   D's bump arena or a new arena if D's free list is empty.
+   Returns a null pointer if memory is not available.
+   D's lock must be held. */
+static struct block *
+desc_get_block (struct desc *d) 
+{
+  struct block *b;
+  struct arena *a;
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
 
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
+  /* Prefer a block from the free list. */
+  if (!list_empty (&d->free_list))
     {
-      size_t i;
+      b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+      block_to_arena (b)->free_cnt--;
+      return b;
+    }
 
-      /* Allocate a page. */
+  /* Otherwise carve one off the bump arena, starting a new arena
+     if there is none or it has been used up. */
+  a = d->bump_arena;
+  if (a == NULL || a->carved_cnt >= d->blocks_per_arena)
+    {
       a = palloc_get_page (0);
       if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
-
-      /* Initialize arena and add its blocks to the free list. */
+        return NULL;
       a->magic = ARENA_MAGIC;
       a->desc = d;
       a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
+      a->carved_cnt = 0;
+      d->bump_arena = a;
+    }
+  b = arena_to_block (a, a->carved_cnt++);
+  a->free_cnt--;
+  return b;
+}
+
+/* Returns block B to descriptor D's free list.  If that leaves
+   B's arena entirely unused, frees the arena.  D's lock must be
+   held. */
+static void
+desc_put_block (struct desc *d, struct block *b) 
+{
+  struct arena *a = block_to_arena (b);
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  /* Add block to free list. */
+  list_push_front (&d->free_list, &b->free_elem);
+
+  /* If the arena is now entirely unused, free it.  Only blocks
+     that have been carved from it are on the free list. */
+  if (++a->free_cnt >= d->blocks_per_arena) 
+    {
+      size_t i;
+
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      for (i = 0; i < a->carved_cnt; i++) 
         {
           struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
+          list_remove (&b->free_elem);
         }
+      if (d->bump_arena == a)
+        d->bump_arena = NULL;
+      palloc_free_page (a);
     }
+}
 
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
+/* Fills half of magazine M from descriptor D, in one critical
+   section. */
+static void
+refill (struct desc *d, struct magazine *m) 
+{
+  size_t want = (d->magazine_size + 1) / 2;
+
+  lock_acquire (&d->lock);
+  while (m->cnt < want)
+    {
+      struct block *b = desc_get_block (d);
+      if (b == NULL)
+        break;
+      b->next = m->top;
+      m->top = b;
+      m->cnt++;
+    }
   lock_release (&d->lock);
-  return b;
+}
+
+/* Returns CNT blocks from magazine M to descriptor D, in one
+   critical section. */
+static void
+drain (struct desc *d, struct magazine *m, size_t cnt) 
+{
+  ASSERT (cnt <= m->cnt);
+
+  lock_acquire (&d->lock);
+  while (cnt-- > 0)
+    {
+      struct block *b = m->top;
+      m->top = b->next;
+      m->cnt--;
+      desc_put_block (d, b);
+    }
+  lock_release (&d->lock);
+}
+
+/* Returns all of the running thread's cached blocks to their
+   descriptors.  Called when the thread exits. */
+void
+malloc_thread_exit (void) 
+{
+  struct thread *t = thread_current ();
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++)
+    if (t->magazines[i].cnt > 0)
+      drain (&descs[i], &t->magazines[i], t->magazines[i].cnt);
 }
 
 /* Allocates and return A times B bytes initialized to zeroes.
@@ -228,31 +361,20 @@ free (void *p)
         {
           /* It's a normal block.  We handle it here. */
 
+          struct magazine *m = &thread_current ()->magazines[d - descs];
+
 #ifndef NDEBUG
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
-  
-          lock_acquire (&d->lock);
-
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
-
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
-            {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
-            }
-
-          lock_release (&d->lock);
+
+          /* Push the block onto the running thread's magazine,
+             first draining half of it if it is full. */
+          if (m->cnt >= d->magazine_size)
+            drain (d, m, m->cnt / 2);
+          b->next = m->top;
+          m->top = b;
+          m->cnt++;
         }
       else
         {
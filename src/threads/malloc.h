@@ -4,7 +4,19 @@
 #include <debug.h>
 #include <stddef.h>
 
+/* Maximum number of malloc() size classes. */
+#define MAGAZINE_CNT 10
+
+/* A thread's private cache of free blocks of one size class,
+   kept as a stack linked through the blocks themselves. */
+struct magazine
+  {
+    struct block *top;          /* Most recently cached block. */
+    size_t cnt;                 /* Number of cached blocks. */
+  };
+
 void malloc_init (void);
+void malloc_thread_exit (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
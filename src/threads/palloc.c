@@ -2,13 +2,14 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,14 +24,63 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is managed as a binary buddy system.  Free pages are
+   kept in blocks of 2**K pages, each aligned (relative to the
+   pool's base) on a 2**K page boundary, on one free list per
+   order K.  An allocation of N pages takes a block of the
+   smallest order that fits, splitting larger blocks in half as
+   needed, and returns the pages past N to the free lists.  A
+   freed block is merged with its "buddy", the other half of the
+   block it was split from, whenever the buddy is also free.
+   Allocation and freeing thus take O(log n) time, and free
+   memory coalesces automatically.
+
+   That is short enough to do with interrupts disabled, which
+   lets pages be freed from places that cannot sleep on a lock,
+   such as thread_schedule_tail() freeing a dying thread.
+
+   Each pool also keeps a small stock of free pages that are
+   already filled with zeros, so that single-page PAL_ZERO
+   requests do not have to clear memory themselves.  The idle
+   thread tops up the stock by calling palloc_prezero().  The
+   stock is handed back to the buddy lists whenever an
+   allocation would otherwise fail. */
+
+/* Most pre-zeroed pages kept, as a fraction of a pool's pages
+   and absolutely. */
+#define ZEROED_FRACTION 32
+#define ZEROED_MAX 64
+
+/* Number of block orders.  The largest block is
+   2**(PALLOC_ORDERS - 1) pages. */
+#define PALLOC_ORDERS 16
+
+/* A free block, stored in its own first page. */
+struct free_block
+  {
+    struct list_elem elem;              /* Element in free list. */
+  };
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    uint8_t *free_order;                /* Per page: order + 1 if the
+                                           page starts a free block,
+                                           otherwise 0. */
+    struct list free_lists[PALLOC_ORDERS]; /* Free blocks by order. */
+    const char *name;                   /* Name, for statistics. */
+
+    /* Free pages already filled with zeros, linked through their
+       first bytes. */
+    struct list zeroed;                 /* Pre-zeroed pages. */
+    size_t zeroed_cnt;                  /* Number of pre-zeroed pages. */
+    size_t zeroed_max;                  /* Most pre-zeroed pages to keep. */
+    unsigned long long zero_hits;       /* PAL_ZERO served pre-zeroed. */
+    unsigned long long zero_misses;     /* PAL_ZERO zeroed on demand. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -38,7 +88,11 @@ static struct pool kernel_pool, user_pool;
 
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
-static bool page_from_pool (const struct pool *, void *page);
+static bool page_from_pool (const struct pool *, const void *page);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
+static struct free_block *idx_to_block (const struct pool *, size_t);
+static void release_zeroed (struct pool *);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -71,15 +125,39 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
+  bool prezeroed = false;
   void *pages;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  old_level = intr_disable ();
+  if ((flags & PAL_ZERO) && page_cnt == 1 && !list_empty (&pool->zeroed))
+    {
+      /* Take a pre-zeroed page. */
+      page_idx = pg_no (list_pop_front (&pool->zeroed)) - pg_no (pool->base);
+      pool->zeroed_cnt--;
+      pool->zero_hits++;
+      prezeroed = true;
+    }
+  else
+    {
+      page_idx = buddy_alloc (pool, page_cnt);
+      if (page_idx == BITMAP_ERROR && pool->zeroed_cnt > 0)
+        {
+          /* Out of memory, or too fragmented: give the
+             pre-zeroed pages back and try again. */
+          release_zeroed (pool);
+          page_idx = buddy_alloc (pool, page_cnt);
+        }
+      if (flags & PAL_ZERO)
+        pool->zero_misses++;
+    }
+  if (page_idx != BITMAP_ERROR)
+    bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+  intr_set_level (old_level);
 
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
@@ -88,7 +166,11 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      /* A pre-zeroed page only needs its free list link
+         cleared. */
+      if (prezeroed)
+        memset (pages, 0, sizeof (struct free_block));
+      else if (flags & PAL_ZERO)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
@@ -118,6 +200,7 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
@@ -137,8 +220,77 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  old_level = intr_disable ();
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  buddy_free (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
+}
+
+/* Zeroes one free page and adds it to its pool's stock of
+   pre-zeroed pages, if a pool's stock is below its limit.
+   Returns true if a page was zeroed, false if there was nothing
+   to do.  Called by the idle thread with interrupts on; the
+   zeroing itself runs with interrupts on, so that it can be
+   preempted. */
+bool
+palloc_prezero (void) 
+{
+  struct pool *pools[] = {&user_pool, &kernel_pool};
+  size_t i;
+
+  for (i = 0; i < sizeof pools / sizeof *pools; i++)
+    {
+      struct pool *pool = pools[i];
+      enum intr_level old_level;
+      struct free_block *b;
+      size_t page_idx;
+
+      old_level = intr_disable ();
+      page_idx = (pool->zeroed_cnt < pool->zeroed_max
+                  ? buddy_alloc (pool, 1) : BITMAP_ERROR);
+      intr_set_level (old_level);
+      if (page_idx == BITMAP_ERROR)
+        continue;
+
+      /* The page is neither free nor allocated while we zero
+         it, so nothing else touches it. */
+      b = idx_to_block (pool, page_idx);
+      memset (b, 0, PGSIZE);
+
+      old_level = intr_disable ();
+      list_push_front (&pool->zeroed, &b->elem);
+      pool->zeroed_cnt++;
+      intr_set_level (old_level);
+      return true;
+    }
+  return false;
+}
+
+/* Returns the number of pages in the user pool. */
+size_t
+palloc_user_page_cnt (void) 
+{
+  return bitmap_size (user_pool.used_map);
+}
+
+/* Returns the index of PAGE within the user pool, from 0 up to
+   palloc_user_page_cnt() - 1.  PAGE must be a user pool page. */
+size_t
+palloc_user_page_no (const void *page) 
+{
+  ASSERT (page_from_pool (&user_pool, page));
+  return pg_no (page) - pg_no (user_pool.base);
+}
+
+/* Prints statistics on pre-zeroed page use. */
+void
+palloc_print_stats (void) 
+{
+  printf ("Zeroed pages: %s %llu hits, %llu misses; "
+          "%s %llu hits, %llu misses\n",
+          kernel_pool.name, kernel_pool.zero_hits, kernel_pool.zero_misses,
+          user_pool.name, user_pool.zero_hits, user_pool.zero_misses);
 }
 
 /* Frees the page at PAGE. */
@@ -153,10 +305,13 @@ palloc_free_page (void *page)
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's used_map at its base, followed by its
+     free_order array.  Calculate the space needed for them
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
+  int order;
+
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -164,15 +319,142 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->free_order = (uint8_t *) base + bm_size;
+  memset (p->free_order, 0, page_cnt);
   p->base = base + bm_pages * PGSIZE;
+  for (order = 0; order < PALLOC_ORDERS; order++)
+    list_init (&p->free_lists[order]);
+  p->name = name;
+  list_init (&p->zeroed);
+  p->zeroed_cnt = 0;
+  p->zeroed_max = page_cnt / ZEROED_FRACTION;
+  if (p->zeroed_max > ZEROED_MAX)
+    p->zeroed_max = ZEROED_MAX;
+  p->zero_hits = p->zero_misses = 0;
+
+  /* Put all of the pool's pages on the free lists. */
+  buddy_free (p, 0, page_cnt);
+}
+
+/* Returns the free block that starts at page PAGE_IDX in POOL. */
+static struct free_block *
+idx_to_block (const struct pool *pool, size_t page_idx) 
+{
+  return (struct free_block *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Adds the block of 2**ORDER pages at PAGE_IDX to POOL's free
+   lists, merging it with its buddy, and the merged block with
+   its buddy, and so on, as long as the buddy is free. */
+static void
+buddy_insert (struct pool *pool, size_t page_idx, int order) 
+{
+  size_t page_cnt = bitmap_size (pool->used_map);
+  struct free_block *b;
+
+  for (; order < PALLOC_ORDERS - 1; order++)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+      if (buddy + ((size_t) 1 << order) > page_cnt
+          || pool->free_order[buddy] != order + 1)
+        break;
+
+      /* Merge with buddy. */
+      list_remove (&idx_to_block (pool, buddy)->elem);
+      pool->free_order[buddy] = 0;
+      page_idx &= ~((size_t) 1 << order);
+    }
+
+  b = idx_to_block (pool, page_idx);
+  list_push_front (&pool->free_lists[order], &b->elem);
+  pool->free_order[page_idx] = order + 1;
+}
+
+/* Returns the PAGE_CNT pages starting at PAGE_IDX in POOL to its
+   free lists, as the largest aligned blocks that they can be
+   divided into. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt) 
+{
+  while (page_cnt > 0)
+    {
+      /* Largest order to which PAGE_IDX is aligned and that fits
+         in PAGE_CNT. */
+      int order = 0;
+      while (order < PALLOC_ORDERS - 1
+             && (page_idx & ((size_t) 1 << order)) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+
+      buddy_insert (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Returns all of POOL's pre-zeroed pages to its free lists.
+   Interrupts must be off. */
+static void
+release_zeroed (struct pool *pool) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (!list_empty (&pool->zeroed))
+    {
+      struct list_elem *e = list_pop_front (&pool->zeroed);
+      buddy_free (pool, pg_no (e) - pg_no (pool->base), 1);
+    }
+  pool->zeroed_cnt = 0;
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL's free lists and
+   returns the index of the first, or BITMAP_ERROR if there is no
+   large enough free block. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt) 
+{
+  int want, order;
+  size_t page_idx;
+
+  /* Smallest order that holds PAGE_CNT pages. */
+  for (want = 0; ((size_t) 1 << want) < page_cnt; want++)
+    if (want == PALLOC_ORDERS - 1)
+      return BITMAP_ERROR;
+
+  /* Smallest nonempty free list of at least that order. */
+  for (order = want; order < PALLOC_ORDERS; order++)
+    if (!list_empty (&pool->free_lists[order]))
+      break;
+  if (order == PALLOC_ORDERS)
+    return BITMAP_ERROR;
+
+  page_idx = pg_no (list_pop_front (&pool->free_lists[order]))
+             - pg_no (pool->base);
+  pool->free_order[page_idx] = 0;
+
+  /* Split the block, returning upper halves to the free lists,
+     until it is the wanted order. */
+  while (order > want)
+    {
+      size_t buddy;
+
+      order--;
+      buddy = page_idx + ((size_t) 1 << order);
+      list_push_front (&pool->free_lists[order],
+                       &idx_to_block (pool, buddy)->elem);
+      pool->free_order[buddy] = order + 1;
+    }
+
+  /* Give back the pages past PAGE_CNT. */
+  buddy_free (pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+  return page_idx;
 }
 
 /* Returns true if PAGE was allocated from POOL,
    false otherwise. */
 static bool
-page_from_pool (const struct pool *pool, void *page) 
+page_from_pool (const struct pool *pool, const void *page) 
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
@@ -0,0 +1,258 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* An object cache hands out objects of a single size, carved
+   from pages called "slabs".  Unlike malloc(), which rounds each
+   request up to a power of 2, a cache packs objects as tightly
+   as their alignment allows, so that each slab holds as many as
+   possible.
+
+   A cache may have a constructor, which puts each object into
+   some initial state when its slab is created.  Objects are
+   expected to be back in that state when they are freed, so
+   that the constructor's work is not repeated for every
+   allocation.  For that reason, free objects are tracked in a
+   bitmap in the slab header rather than in a list threaded
+   through the objects themselves.
+
+   Slabs with free objects are kept on the cache's partial list,
+   and full slabs on its full list.  One completely free slab is
+   kept around to absorb alternating allocations and frees; any
+   others are returned to the page allocator. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Object cache. */
+struct kmem_cache
+  {
+    struct list_elem elem;      /* Element in all_caches. */
+    char name[16];              /* Name, for statistics. */
+    size_t obj_size;            /* Object size, rounded to alignment. */
+    size_t obj_ofs;             /* Offset of first object in a slab. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    kmem_ctor *ctor;            /* Constructor, or a null pointer. */
+    struct lock lock;           /* Protects members below. */
+    struct list partial;        /* Slabs with at least one free object. */
+    struct list full;           /* Slabs with no free objects. */
+    bool have_empty;            /* Is a slab on PARTIAL entirely free? */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Slabs in use. */
+    size_t obj_cnt;             /* Objects allocated. */
+    size_t peak_obj_cnt;        /* Most objects ever allocated at once. */
+    unsigned long long alloc_cnt; /* Calls to kmem_cache_alloc(). */
+  };
+
+/* Slab header, at the start of each slab's page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in cache's partial or full list. */
+    size_t free_cnt;            /* Number of free objects. */
+    uint32_t free_map[];        /* 1-bit for each free object. */
+  };
+
+/* Number of free_map words needed for CNT objects. */
+#define FREE_MAP_WORDS(CNT) DIV_ROUND_UP (CNT, 32)
+
+/* All caches, for statistics. */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+
+/* Creates and returns a cache of objects SIZE bytes long, each
+   aligned on an ALIGN-byte boundary (a power of 2, or 0 for
+   word alignment).  If CTOR is non-null, it is called on each
+   object when the object's slab is created.  NAME identifies
+   the cache in statistics.  Panics if memory is not available,
+   since caches are created while the kernel initializes. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, size_t align,
+                   kmem_ctor *ctor) 
+{
+  struct kmem_cache *c;
+  size_t cnt;
+
+  if (align == 0)
+    align = sizeof (void *);
+  ASSERT (size > 0);
+  ASSERT ((align & (align - 1)) == 0);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    PANIC ("can't allocate object cache %s", name);
+
+  strlcpy (c->name, name, sizeof c->name);
+  c->obj_size = ROUND_UP (size, align);
+  c->ctor = ctor;
+  lock_init (&c->lock);
+  list_init (&c->partial);
+  list_init (&c->full);
+  c->have_empty = false;
+  c->slab_cnt = c->obj_cnt = c->peak_obj_cnt = 0;
+  c->alloc_cnt = 0;
+
+  /* Fit as many objects into a page as possible, along with a
+     header whose free map has a bit for each of them. */
+  for (cnt = (PGSIZE - sizeof (struct slab)) / c->obj_size; cnt > 0; cnt--)
+    {
+      c->obj_ofs = ROUND_UP (sizeof (struct slab)
+                             + FREE_MAP_WORDS (cnt) * sizeof (uint32_t),
+                             align);
+      if (c->obj_ofs + cnt * c->obj_size <= PGSIZE)
+        break;
+    }
+  if (cnt == 0)
+    PANIC ("objects in cache %s too big for a slab", name);
+  c->objs_per_slab = cnt;
+
+  list_push_back (&all_caches, &c->elem);
+  return c;
+}
+
+/* Returns object IDX in slab S. */
+static void *
+slab_object (struct slab *s, size_t idx) 
+{
+  return (uint8_t *) s + s->cache->obj_ofs + idx * s->cache->obj_size;
+}
+
+/* Allocates and adds a new slab to cache C, constructing each of
+   its objects.  Returns the slab, or a null pointer if no page
+   is available.  C's lock must be held. */
+static struct slab *
+slab_create (struct kmem_cache *c) 
+{
+  struct slab *s = palloc_get_page (0);
+  size_t i;
+
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->free_cnt = c->objs_per_slab;
+  memset (s->free_map, 0,
+          FREE_MAP_WORDS (c->objs_per_slab) * sizeof (uint32_t));
+  for (i = 0; i < c->objs_per_slab; i++)
+    s->free_map[i / 32] |= 1u << (i % 32);
+  if (c->ctor != NULL)
+    for (i = 0; i < c->objs_per_slab; i++)
+      c->ctor (slab_object (s, i));
+
+  list_push_front (&c->partial, &s->elem);
+  c->slab_cnt++;
+  return s;
+}
+
+/* Allocates and returns an object from cache C, or a null
+   pointer if memory is not available.  The object is in the
+   state its constructor, or its last user, left it in. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) 
+{
+  struct slab *s;
+  size_t word, idx;
+
+  lock_acquire (&c->lock);
+  if (list_empty (&c->partial) && slab_create (c) == NULL)
+    {
+      lock_release (&c->lock);
+      return NULL;
+    }
+  s = list_entry (list_front (&c->partial), struct slab, elem);
+  if (s->free_cnt == c->objs_per_slab)
+    c->have_empty = false;
+
+  /* Take the first free object. */
+  for (word = 0; s->free_map[word] == 0; word++)
+    continue;
+  idx = word * 32 + __builtin_ctz (s->free_map[word]);
+  s->free_map[word] &= ~(1u << (idx % 32));
+  if (--s->free_cnt == 0)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full, &s->elem);
+    }
+
+  c->alloc_cnt++;
+  if (++c->obj_cnt > c->peak_obj_cnt)
+    c->peak_obj_cnt = c->obj_cnt;
+  lock_release (&c->lock);
+
+  return slab_object (s, idx);
+}
+
+/* Returns OBJ, which must have been allocated from cache C, to
+   C. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) 
+{
+  struct slab *s;
+  size_t idx;
+
+  if (obj == NULL)
+    return;
+
+  s = pg_round_down (obj);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  ASSERT ((pg_ofs (obj) - c->obj_ofs) % c->obj_size == 0);
+  idx = (pg_ofs (obj) - c->obj_ofs) / c->obj_size;
+  ASSERT (idx < c->objs_per_slab);
+
+  lock_acquire (&c->lock);
+  ASSERT ((s->free_map[idx / 32] & (1u << (idx % 32))) == 0);
+  s->free_map[idx / 32] |= 1u << (idx % 32);
+  c->obj_cnt--;
+  if (s->free_cnt++ == 0)
+    {
+      /* Slab was full. */
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  if (s->free_cnt == c->objs_per_slab)
+    {
+      /* Slab is now entirely free.  Keep one such slab, at the
+         back of the partial list so that partially used slabs
+         fill up first, and release any others. */
+      list_remove (&s->elem);
+      if (!c->have_empty)
+        {
+          list_push_back (&c->partial, &s->elem);
+          c->have_empty = true;
+        }
+      else
+        {
+          c->slab_cnt--;
+          palloc_free_page (s);
+        }
+    }
+  lock_release (&c->lock);
+}
+
+/* Prints statistics for each object cache. */
+void
+kmem_print_stats (void) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      printf ("Cache %s: %zu-byte objects, %zu in use (peak %zu), "
+              "%zu slabs of %zu, %llu allocations\n",
+              c->name, c->obj_size, c->obj_cnt, c->peak_obj_cnt,
+              c->slab_cnt, c->objs_per_slab, c->alloc_cnt);
+    }
+}
@@ -184,7 +184,7 @@ donate_priority_recursively(struct lock *lock, int priority)
     return;
   
   lock->priority = lock->priority > priority ? lock->priority : priority;
-  lock->holder->donation_priority = lock->holder->donation_priority > priority ? lock->holder->donation_priority : priority;
+  thread_donate_priority (lock->holder, priority);
   
   donate_priority_recursively(lock->holder->thread_lock, priority);
 }
@@ -284,6 +284,121 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
+/* Initializes RWLOCK.  A readers-writer lock may be held by any
+   number of readers at once, or by a single writer.
+
+   Once a writer is waiting, new readers wait too, so that a
+   steady stream of readers cannot starve writers.  When a writer
+   releases the lock, all waiting readers are let in ahead of the
+   next writer, so that writers cannot starve readers either.
+   Ownership passes directly from the releasing thread to the
+   threads it wakes up. */
+void
+rwlock_init (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_init (&rwlock->guard);
+  rwlock->readers = 0;
+  rwlock->writer = false;
+  rwlock->waiting_readers = 0;
+  rwlock->waiting_writers = 0;
+  sema_init (&rwlock->read_sema, 0);
+  sema_init (&rwlock->write_sema, 0);
+}
+
+/* Acquires RWLOCK for reading, sleeping until no writer holds or
+   is waiting for it.  Must not be called within an interrupt
+   handler. */
+void
+rwlock_acquire_read (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rwlock->guard);
+  if (rwlock->writer || rwlock->waiting_writers > 0)
+    {
+      rwlock->waiting_readers++;
+      lock_release (&rwlock->guard);
+      sema_down (&rwlock->read_sema);
+    }
+  else
+    {
+      rwlock->readers++;
+      lock_release (&rwlock->guard);
+    }
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   reading.  The last reader out hands the lock to a waiting
+   writer, if any. */
+void
+rwlock_release_read (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_acquire (&rwlock->guard);
+  ASSERT (rwlock->readers > 0);
+  if (--rwlock->readers == 0 && rwlock->waiting_writers > 0)
+    {
+      rwlock->waiting_writers--;
+      rwlock->writer = true;
+      sema_up (&rwlock->write_sema);
+    }
+  lock_release (&rwlock->guard);
+}
+
+/* Acquires RWLOCK for writing, sleeping until no other thread
+   holds it.  Must not be called within an interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rwlock->guard);
+  if (rwlock->writer || rwlock->readers > 0)
+    {
+      rwlock->waiting_writers++;
+      lock_release (&rwlock->guard);
+      sema_down (&rwlock->write_sema);
+    }
+  else
+    {
+      rwlock->writer = true;
+      lock_release (&rwlock->guard);
+    }
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   writing.  Hands the lock to all waiting readers, or failing
+   that to one waiting writer. */
+void
+rwlock_release_write (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_acquire (&rwlock->guard);
+  ASSERT (rwlock->writer);
+  rwlock->writer = false;
+  if (rwlock->waiting_readers > 0)
+    {
+      for (; rwlock->waiting_readers > 0; rwlock->waiting_readers--)
+        {
+          rwlock->readers++;
+          sema_up (&rwlock->read_sema);
+        }
+    }
+  else if (rwlock->waiting_writers > 0)
+    {
+      rwlock->waiting_writers--;
+      rwlock->writer = true;
+      sema_up (&rwlock->write_sema);
+    }
+  lock_release (&rwlock->guard);
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem 
 {
@@ -46,6 +46,26 @@ void cond_wait (struct condition *cond, struct lock *lock);
 void cond_signal (struct condition *cond, struct lock *lock);
 void cond_broadcast (struct condition *cond, struct lock *lock);
 
+/* Readers-writer lock: Held by any number of readers at once, or
+   by a single writer. */
+struct rwlock 
+{
+    struct lock guard;              /* Protects the members below. */
+    int readers;                    /* Number of readers holding the lock. */
+    bool writer;                    /* Held by a writer? */
+    int waiting_readers;            /* Readers blocked on read_sema. */
+    int waiting_writers;            /* Writers blocked on write_sema. */
+    struct semaphore read_sema;     /* Readers wait here. */
+    struct semaphore write_sema;    /* Writers wait here. */
+};
+
+/* Readers-writer lock operations. */
+void rwlock_init (struct rwlock *rwlock);
+void rwlock_acquire_read (struct rwlock *rwlock);
+void rwlock_release_read (struct rwlock *rwlock);
+void rwlock_acquire_write (struct rwlock *rwlock);
+void rwlock_release_write (struct rwlock *rwlock);
+
 /* Function to sort condition variable waiters based on priority. */
 bool cond_priority_cmp(const struct list_elem *a, const struct list_elem *b, void *aux);
 
@@ -4,6 +4,8 @@
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
+#include "threads/fixed-point.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
@@ -19,8 +21,15 @@
 /* Random value for detecting stack overflow in struct thread. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* Lists for ready and all threads. */
-static struct list ready_list;  /* Threads ready to run. */
+/* Ready queue: one FIFO list per priority level, plus a bitmap
+   in which bit P is set iff ready_queues[P] is nonempty.  Adding
+   a thread and picking the highest-priority one both take
+   constant time, independent of the number of ready threads. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_mask;
+static int ready_cnt;           /* Number of threads in ready_queues. */
+
+/* List of all threads. */
 static struct list all_list;    /* All threads in the system. */
 
 /* Idle and initial threads. */
@@ -48,12 +57,32 @@ static long long user_ticks;    /* Time spent in user programs. */
 static unsigned thread_ticks;   /* Timer ticks since last yield. */
 bool thread_mlfqs;              /* Multi-level feedback queue scheduler flag. */
 
+/* Multi-level feedback queue scheduler state. */
+#define NICE_MIN -20            /* Nicest possible thread. */
+#define NICE_MAX 20             /* Least nice possible thread. */
+static fixed_t load_avg;        /* System load average. */
+
+/* Threads whose recent_cpu has grown since priorities were last
+   recomputed.  Only the running thread gains recent_cpu, one
+   tick at a time, so at most TIME_SLICE threads can be here
+   between two recomputations. */
+static struct thread *mlfqs_dirty[TIME_SLICE];
+static int mlfqs_dirty_cnt;
+
 /* Function prototypes for internal thread operations. */
 static void kernel_thread (thread_func *, void *aux);
 static void idle (void *aux UNUSED);
 static struct thread *running_thread (void);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
+static int effective_priority (const struct thread *);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static int ready_highest_priority (void);
+static void mlfqs_tick (struct thread *);
+static void mlfqs_update_priority (struct thread *);
+static void mlfqs_decay (struct thread *, void *aux);
+static void mlfqs_forget (struct thread *);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
@@ -63,10 +92,14 @@ static tid_t allocate_tid (void);
 /* Initializes the threading system. */
 void thread_init (void) 
 {
+    int pri;
+
     ASSERT (intr_get_level () == INTR_OFF);
 
     lock_init (&tid_lock);
-    list_init (&ready_list);
+    for (pri = PRI_MIN; pri <= PRI_MAX; pri++)
+        list_init (&ready_queues[pri]);
+    ready_mask = 0;
     list_init (&all_list);
 
     /* Set up the initial thread structure. */
@@ -74,6 +107,8 @@ void thread_init (void)
     init_thread (initial_thread, "main", PRI_DEFAULT);
     initial_thread->status = THREAD_RUNNING;
     initial_thread->tid = allocate_tid ();
+    if (thread_mlfqs)
+        mlfqs_update_priority (initial_thread);
 }
 
 /* Starts preemptive thread scheduling and creates the idle thread. */
@@ -105,11 +140,120 @@ void thread_tick (void)
     else
         kernel_ticks++;
 
+    if (thread_mlfqs)
+        mlfqs_tick (t);
+
     /* Enforce preemption if necessary. */
     if (++thread_ticks >= TIME_SLICE)
         intr_yield_on_return ();
 }
 
+/* Accounts for CNT timer ticks that passed without a timer
+   interrupt while the idle thread had the CPU halted.  See
+   timer_idle_enter(). */
+void thread_tick_idle (int64_t cnt)
+{
+    idle_ticks += cnt;
+}
+
+/* Updates the 4.4BSD scheduler state for one timer tick, with T
+   the running thread.
+
+   Rather than recomputing every thread's priority every fourth
+   tick, only threads whose recent_cpu changed since the last
+   recomputation are visited then; everyone else's inputs are
+   unchanged.  All threads are visited only once per second, when
+   recent_cpu decays. */
+static void mlfqs_tick (struct thread *t)
+{
+    int64_t now = timer_ticks ();
+    int i;
+
+    if (t != idle_thread)
+    {
+        t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+        for (i = 0; i < mlfqs_dirty_cnt; i++)
+            if (mlfqs_dirty[i] == t)
+                break;
+        if (i == mlfqs_dirty_cnt)
+        {
+            ASSERT (mlfqs_dirty_cnt < TIME_SLICE);
+            mlfqs_dirty[mlfqs_dirty_cnt++] = t;
+        }
+    }
+
+    if (now % TIMER_FREQ == 0)
+    {
+        int ready_threads = ready_cnt + (t != idle_thread);
+        load_avg = fp_mul (fp_div (fp_from_int (59), fp_from_int (60)), load_avg)
+                   + fp_from_int (ready_threads) / 60;
+        thread_foreach (mlfqs_decay, NULL);
+        mlfqs_dirty_cnt = 0;
+    }
+    else if (now % TIME_SLICE == 0)
+    {
+        for (i = 0; i < mlfqs_dirty_cnt; i++)
+            mlfqs_update_priority (mlfqs_dirty[i]);
+        mlfqs_dirty_cnt = 0;
+    }
+
+    if (ready_highest_priority () > t->priority)
+        intr_yield_on_return ();
+}
+
+/* Decays T's recent_cpu by the load average and recomputes its
+   priority.  Called once per second for every thread. */
+static void mlfqs_decay (struct thread *t, void *aux UNUSED)
+{
+    fixed_t twice_load = 2 * load_avg;
+
+    if (t == idle_thread)
+        return;
+
+    t->recent_cpu = fp_add_int (fp_mul (fp_div (twice_load, fp_add_int (twice_load, 1)),
+                                        t->recent_cpu),
+                                t->nice);
+    mlfqs_update_priority (t);
+}
+
+/* Recomputes T's priority from its recent_cpu and nice value,
+   moving it to the right ready queue if it is waiting to run. */
+static void mlfqs_update_priority (struct thread *t)
+{
+    int priority = PRI_MAX - fp_to_int (t->recent_cpu / 4) - t->nice * 2;
+
+    if (priority < PRI_MIN)
+        priority = PRI_MIN;
+    else if (priority > PRI_MAX)
+        priority = PRI_MAX;
+
+    if (priority == t->priority)
+        return;
+
+    if (t->status == THREAD_READY)
+    {
+        ready_remove (t);
+        t->priority = priority;
+        ready_push (t);
+    }
+    else
+        t->priority = priority;
+}
+
+/* Drops T from the set of threads awaiting priority
+   recomputation, because T is about to be destroyed. */
+static void mlfqs_forget (struct thread *t)
+{
+    int i;
+
+    for (i = 0; i < mlfqs_dirty_cnt; i++)
+        if (mlfqs_dirty[i] == t)
+        {
+            mlfqs_dirty[i] = mlfqs_dirty[--mlfqs_dirty_cnt];
+            break;
+        }
+}
+
 /* Prints thread scheduling statistics. */
 void thread_print_stats (void) 
 {
@@ -137,6 +281,16 @@ tid_t thread_create (const char *name, int priority, thread_func *function, void
     init_thread (t, name, priority);
     tid = t->tid = allocate_tid ();
 
+    /* Under the 4.4BSD scheduler, the new thread inherits its
+       parent's niceness and recent CPU, and PRIORITY is ignored. */
+    if (thread_mlfqs)
+    {
+        struct thread *parent = thread_current ();
+        t->nice = parent->nice;
+        t->recent_cpu = parent->recent_cpu;
+        mlfqs_update_priority (t);
+    }
+
     /* Set up stack frames for kernel_thread(). */
     kf = alloc_frame (t, sizeof *kf);
     kf->eip = NULL;
@@ -178,7 +332,7 @@ void thread_unblock (struct thread *t)
 
     old_level = intr_disable ();
     ASSERT (t->status == THREAD_BLOCKED);
-    list_push_back (&ready_list, &t->elem);
+    ready_push (t);
     t->status = THREAD_READY;
     intr_set_level (old_level);
 }
@@ -213,21 +367,16 @@ void thread_exit (void)
     process_exit ();
 #endif
 
+    malloc_thread_exit ();
     intr_disable ();
     list_remove (&thread_current()->allelem);
+    if (thread_mlfqs)
+        mlfqs_forget (thread_current ());
     thread_current ()->status = THREAD_DYING;
     schedule ();
     NOT_REACHED ();
 }
 
-/* Compares wake-up times of threads for sleeping. */
-bool wake_up_time_less(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED) 
-{
-    struct thread *t1 = list_entry(a, struct thread, elem);
-    struct thread *t2 = list_entry(b, struct thread, elem);
-    return t1->wake_up_time < t2->wake_up_time;
-}
-
 /* Yields the CPU to another thread. */
 void thread_yield (void) 
 {
@@ -238,7 +387,7 @@ void thread_yield (void)
 
     old_level = intr_disable ();
     if (cur != idle_thread) 
-        list_push_back (&ready_list, &cur->elem);
+        ready_push (cur);
     cur->status = THREAD_READY;
     schedule ();
     intr_set_level (old_level);
@@ -259,9 +408,13 @@ void thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
-/* Sets the current thread's priority. */
+/* Sets the current thread's priority.  Ignored under the
+   4.4BSD scheduler, which computes priorities itself. */
 void thread_set_priority (int new_priority) 
 {
+    if (thread_mlfqs)
+        return;
+
     thread_current ()->priority = new_priority;
     thread_yield();
 }
@@ -273,17 +426,74 @@ int thread_get_priority (void)
     return (t->donation_priority > t->priority) ? t->donation_priority : t->priority;
 }
 
-/* Not yet implemented. */
-void thread_set_nice (int nice UNUSED) {}
+/* Raises T's donated priority to PRIORITY, if that is higher
+   than what it already has.  If T is waiting to run, it moves to
+   the ready queue for its new effective priority.  Interrupts
+   must be off. */
+void thread_donate_priority (struct thread *t, int priority)
+{
+    ASSERT (is_thread (t));
+    ASSERT (intr_get_level () == INTR_OFF);
+
+    /* The 4.4BSD scheduler does not do priority donation. */
+    if (thread_mlfqs || priority <= t->donation_priority)
+        return;
+
+    if (t->status == THREAD_READY)
+    {
+        ready_remove (t);
+        t->donation_priority = priority;
+        ready_push (t);
+    }
+    else
+        t->donation_priority = priority;
+}
+
+/* Sets the current thread's nice value to NICE, recomputes its
+   priority, and yields if it no longer has the highest. */
+void thread_set_nice (int nice) 
+{
+    struct thread *cur = thread_current ();
+    enum intr_level old_level;
+
+    if (nice < NICE_MIN)
+        nice = NICE_MIN;
+    else if (nice > NICE_MAX)
+        nice = NICE_MAX;
+
+    old_level = intr_disable ();
+    cur->nice = nice;
+    if (thread_mlfqs)
+        mlfqs_update_priority (cur);
+    intr_set_level (old_level);
+
+    if (ready_highest_priority () > cur->priority)
+        thread_yield ();
+}
 
-/* Not yet implemented. */
-int thread_get_nice (void) { return 0; }
+/* Returns the current thread's nice value. */
+int thread_get_nice (void) 
+{
+    return thread_current ()->nice;
+}
 
-/* Not yet implemented. */
-int thread_get_load_avg (void) { return 0; }
+/* Returns 100 times the system load average. */
+int thread_get_load_avg (void) 
+{
+    enum intr_level old_level = intr_disable ();
+    int load = fp_to_int_round (load_avg * 100);
+    intr_set_level (old_level);
+    return load;
+}
 
-/* Not yet implemented. */
-int thread_get_recent_cpu (void) { return 0; }
+/* Returns 100 times the current thread's recent_cpu value. */
+int thread_get_recent_cpu (void) 
+{
+    enum intr_level old_level = intr_disable ();
+    int recent = fp_to_int_round (thread_current ()->recent_cpu * 100);
+    intr_set_level (old_level);
+    return recent;
+}
 
 /* The idle thread, which runs when no other threads are ready. */
 static void idle (void *idle_started_ UNUSED) 
@@ -295,7 +505,22 @@ static void idle (void *idle_started_ UNUSED)
     for (;;) 
     {
         intr_disable ();
+        timer_idle_exit ();
         thread_block ();
+
+        /* Use the spare time to zero free pages for later PAL_ZERO
+           allocations.  Interrupts stay on meanwhile, and once a
+           thread becomes ready we go run it instead of halting. */
+        intr_enable ();
+        while (ready_mask == 0 && palloc_prezero ())
+            continue;
+        intr_disable ();
+        if (ready_mask != 0)
+            continue;
+
+        /* Nothing else can run, so the timer may stop ticking
+           until the next sleeper is due. */
+        timer_idle_enter ();
         asm volatile ("sti; hlt" : : : "memory");
     }
 }
@@ -341,6 +566,10 @@ static void init_thread (struct thread *t, const char *name, int priority)
     list_init(&t->lock_list);
     t->thread_lock = NULL;
     t->donation_priority = PRI_MIN;
+#ifdef USERPROG
+    t->exit_code = -1;
+    list_init (&t->children);
+#endif
     t->magic = THREAD_MAGIC;
     old_level = intr_disable ();
     list_push_back (&all_list, &t->allelem);
@@ -357,17 +586,64 @@ static void *alloc_frame (struct thread *t, size_t size)
     return t->stack;
 }
 
-/* Chooses and returns the next thread to run. */
+/* Returns T's priority including any donation. */
+static int effective_priority (const struct thread *t)
+{
+    return t->donation_priority > t->priority ? t->donation_priority : t->priority;
+}
+
+/* Appends T to the back of the ready queue for its effective
+   priority. */
+static void ready_push (struct thread *t)
+{
+    int pri = effective_priority (t);
+
+    list_push_back (&ready_queues[pri], &t->elem);
+    ready_mask |= (uint64_t) 1 << pri;
+    ready_cnt++;
+}
+
+/* Removes T from its ready queue.  T's effective priority must
+   not have changed since it was pushed. */
+static void ready_remove (struct thread *t)
+{
+    int pri = effective_priority (t);
+
+    list_remove (&t->elem);
+    if (list_empty (&ready_queues[pri]))
+        ready_mask &= ~((uint64_t) 1 << pri);
+    ready_cnt--;
+}
+
+/* Returns the highest priority of any ready thread, or -1 if no
+   thread is ready. */
+static int ready_highest_priority (void)
+{
+    uint32_t high = ready_mask >> 32;
+    uint32_t low = ready_mask;
+
+    if (high != 0)
+        return 63 - __builtin_clz (high);
+    else if (low != 0)
+        return 31 - __builtin_clz (low);
+    else
+        return -1;
+}
+
+/* Chooses and returns the next thread to run: the front of the
+   highest nonempty ready queue, found from the highest set bit
+   in ready_mask. */
 static struct thread *next_thread_to_run (void) 
 {
-    if (list_empty (&ready_list))
+    int pri = ready_highest_priority ();
+    struct thread *t;
+
+    if (pri < 0)
         return idle_thread;
-    else   
-    {
-        struct list_elem* max_thread = list_max(&ready_list, thread_priority_compare, NULL);
-        list_remove(max_thread);
-        return list_entry(max_thread, struct thread, elem);
-    }
+
+    t = list_entry (list_front (&ready_queues[pri]), struct thread, elem);
+    ready_remove (t);
+    return t;
 }
 
 /* Completes a thread switch. */
@@ -402,6 +678,12 @@ static void schedule (void)
     ASSERT (cur->status != THREAD_RUNNING);
     ASSERT (is_thread (next));
 
+    /* The idle thread may be switched out straight from an
+       interrupt without passing through its loop again, and the
+       thread taking over needs timer ticks. */
+    if (cur == idle_thread && next != idle_thread)
+        timer_idle_exit ();
+
     if (cur != next)
         prev = switch_threads (cur, next);
     thread_schedule_tail (prev);
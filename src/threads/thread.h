@@ -2,8 +2,11 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
+#include "threads/malloc.h"
 
 /* Thread life cycle states. */
 enum thread_status
@@ -23,6 +26,12 @@ typedef int tid_t;
 #define PRI_DEFAULT 31          /* Default priority. */
 #define PRI_MAX 63              /* Highest priority. */
 
+/* The ready queue keeps one bit per priority level in a 64-bit
+   mask. */
+#if PRI_MAX - PRI_MIN + 1 > 64
+#error ready queue bitmap supports at most 64 priority levels
+#endif
+
 /* Kernel thread or user process.
 
    A thread's structure is stored at the bottom of its 4 kB page.
@@ -41,7 +50,10 @@ struct thread
     uint8_t *stack;                    /* Saved stack pointer. */
     int priority;                      /* Current thread priority. */
     struct list_elem allelem;           /* List element for all threads list. */
-    int64_t wake_up_time;              /* Time to wake up (used in sleeping). */
+    int64_t wake_up_time;              /* Time to wake up, in PIT cycles (used in sleeping). */
+    struct thread *sleep_left;         /* Left child in timer.c's sleeper heap. */
+    struct thread *sleep_right;        /* Right child in timer.c's sleeper heap. */
+    int sleep_rank;                    /* Rank in timer.c's sleeper heap. */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;             /* List element for ready list or semaphore wait list. */
@@ -49,6 +61,24 @@ struct thread
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                 /* Page directory for user programs. */
+    struct file *executable;           /* Running executable, kept open. */
+    int exit_code;                     /* Exit code, -1 unless set by exit(). */
+    struct wait_status *wait_status;   /* This process's completion status. */
+    struct list children;              /* Completion status of children. */
+
+    /* Owned by userprog/syscall.c. */
+    struct file **fd_table;            /* Open files, indexed by handle. */
+    struct bitmap *fd_map;             /* File handles in use. */
+    size_t fd_cnt;                     /* Size of fd_table and fd_map. */
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;                 /* Supplemental page table. */
+    void *user_esp;                    /* User %esp on syscall entry. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;              /* Memory-mapped files. */
+    int next_mapid;                    /* Next mapping identifier. */
+#endif
 #endif
 
     /* Owned by thread.c. */
@@ -56,6 +86,11 @@ struct thread
     struct list lock_list;             /* List of locks acquired by the thread. */
     struct lock *thread_lock;          /* Pointer to the lock the thread is blocked on. */
     int donation_priority;             /* Donated priority from another thread. */
+    int nice;                          /* Niceness, for the 4.4BSD scheduler. */
+    fixed_t recent_cpu;                /* Recent CPU time, for the 4.4BSD scheduler. */
+
+    /* Owned by malloc.c. */
+    struct magazine magazines[MAGAZINE_CNT]; /* Cached free blocks. */
 };
 
 /* If false (default), use round-robin scheduler.
@@ -69,6 +104,7 @@ void thread_start (void);
 
 /* Thread tick and stats functions. */
 void thread_tick (void);
+void thread_tick_idle (int64_t cnt);
 void thread_print_stats (void);
 
 /* Thread management and scheduling functions. */
@@ -90,6 +126,7 @@ void thread_foreach (thread_action_func *, void *);
 /* Thread priority manipulation functions. */
 int thread_get_priority (void);
 void thread_set_priority (int new_priority);
+void thread_donate_priority (struct thread *, int priority);
 
 /* Functions related to nice value, recent CPU, and load average.
    These are used when the multi-level feedback queue scheduler is enabled. */
@@ -98,8 +135,7 @@ void thread_set_nice (int nice);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
-/* Comparator functions for sleeping threads and priority scheduling. */
-bool wake_up_time_less(const struct list_elem *a, const struct list_elem *b, void *aux);
+/* Comparator functions for priority scheduling. */
 bool thread_priority_compare(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
 bool priority_compare(struct thread *first, struct thread *second);
 
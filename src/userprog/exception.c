@@ -2,13 +2,20 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/usermem.h"
+#include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
 static void kill (struct intr_frame *);
+static void debug_exception (struct intr_frame *);
 static void page_fault (struct intr_frame *);
 
 /* Registers handlers for interrupts that can be caused by user
@@ -20,9 +27,12 @@ static void page_fault (struct intr_frame *);
    signals.  Instead, we'll make them simply kill the user
    process.
 
-   Page faults are an exception.  Here they are treated the same
-   way as other exceptions, but this will need to change to
-   implement virtual memory.
+   Page faults are an exception.  Under virtual memory, most of
+   them are resolved by bringing in the page, growing the stack,
+   or breaking copy-on-write sharing, and the faulting
+   instruction is retried.  Kernel faults in the user memory
+   accessors of userprog/usermem.c are reported back to them.
+   Only the rest kill the process or panic the kernel.
 
    Refer to [IA32-v3a] section 5.15 "Exception and Interrupt
    Reference" for a description of each of these exceptions. */
@@ -43,7 +53,6 @@ exception_init (void)
      caused indirectly, e.g. #DE can be caused by dividing by
      0.  */
   intr_register_int (0, 0, INTR_ON, kill, "#DE Divide Error");
-  intr_register_int (1, 0, INTR_ON, kill, "#DB Debug Exception");
   intr_register_int (6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
   intr_register_int (7, 0, INTR_ON, kill,
                      "#NM Device Not Available Exception");
@@ -56,7 +65,11 @@ exception_init (void)
 
   /* Most exceptions can be handled with interrupts turned on.
      We need to disable interrupts for page faults because the
-     fault address is stored in CR2 and needs to be preserved. */
+     fault address is stored in CR2 and needs to be preserved,
+     and for debug exceptions because they may arrive on the
+     small stack that SYSENTER switches to. */
+  intr_register_int (1, 0, INTR_OFF, debug_exception,
+                     "#DB Debug Exception");
   intr_register_int (14, 0, INTR_OFF, page_fault, "#PF Page-Fault Exception");
 }
 
@@ -108,9 +121,35 @@ kill (struct intr_frame *f)
     }
 }
 
-/* Page fault handler.  This is a skeleton that must be filled in
-   to implement virtual memory.  Some solutions to project 2 may
-   also require modifying this code.
+/* Debug exception handler.  A process that sets the trap flag
+   and executes SYSENTER, which does not clear the flag, takes a
+   single-step trap in the kernel at the start of sysenter_entry
+   (in userprog/sysenter.S), possibly still on the small stack
+   that SYSENTER switches to, where nothing may block or look at
+   the current thread.  Clear the flag and resume; the process
+   returns from the system call with it cleared.  Any other
+   debug exception is handled like other exceptions. */
+static void
+debug_exception (struct intr_frame *f) 
+{
+  extern char sysenter_entry[], sysenter_kernel_stack[];
+
+  if (f->cs == SEL_KCSEG
+      && ((char *) f->eip == sysenter_entry
+          || (char *) f->eip == sysenter_kernel_stack))
+    {
+      f->eflags &= ~FLAG_TF;
+      return;
+    }
+
+  intr_enable ();
+  kill (f);
+}
+
+/* Page fault handler.  Resolves faults on pages of the process
+   that are valid but not in memory or still shared, and faults
+   taken by the kernel in the user memory accessors.  Kills the
+   process, or panics on a kernel bug, for any other fault.
 
    At entry, the address that faulted is in CR2 (Control Register
    2) and information about the fault, formatted as described in
@@ -148,9 +187,44 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
-  /* To implement virtual memory, delete the rest of the function
-     body, and replace it with code that brings in the page to
-     which fault_addr refers. */
+#ifdef VM
+  /* A page of the process that has not been brought in yet, a
+     push onto the stack just past its end, or a write to a page
+     that is still shared copy-on-write.  Fix it up and let the
+     faulting instruction run again.  A fault in the kernel on
+     behalf of a system call is judged against the stack pointer
+     the process had when it made the call. */
+  if (is_user_vaddr (fault_addr))
+    {
+      void *esp = user ? f->esp : thread_current ()->user_esp;
+      if (not_present
+          ? (page_load (fault_addr, write)
+             || page_grow_stack (fault_addr, esp))
+          : write && page_unshare (fault_addr))
+        return;
+    }
+#endif
+
+  /* A kernel access to a user address that is not mapped, made
+     by one of the functions in userprog/usermem.c.  They list the
+     address to resume at for each access in a table, and report
+     failure if they find %eax set to 0 there.  Any other kernel
+     fault falls through and panics. */
+  if (!user && is_user_vaddr (fault_addr))
+    {
+      void *resume = usermem_fixup (f->eip);
+      if (resume != NULL)
+        {
+          f->eip = (void (*) (void)) resume;
+          f->eax = 0;
+          return;
+        }
+    }
+
+  /* Nothing could resolve the fault.  It is a user access to an
+     invalid address or in violation of a page's protection, which
+     kills the process, or a kernel fault outside the usermem
+     fixup table, which is a kernel bug. */
   printf ("Page fault at %p: %s error %s page in %s context.\n",
           fault_addr,
           not_present ? "not present" : "rights violation",
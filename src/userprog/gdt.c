@@ -37,7 +37,9 @@ gdt_init (void)
 {
   uint64_t gdtr_operand;
 
-  /* Initialize GDT. */
+  /* Initialize GDT.  SYSENTER and SYSEXIT (see userprog/tss.c)
+     require the kernel data, user code, and user data segments
+     to follow the kernel code segment in this order. */
   gdt[SEL_NULL / sizeof *gdt] = 0;
   gdt[SEL_KCSEG / sizeof *gdt] = make_code_desc (0);
   gdt[SEL_KDSEG / sizeof *gdt] = make_data_desc (0);
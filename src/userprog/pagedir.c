@@ -7,7 +7,7 @@
 #include "threads/palloc.h"
 
 static uint32_t *active_pd (void);
-static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (uint32_t *, const void *);
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -152,7 +152,7 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_page (pd, upage);
     }
 }
 
@@ -180,7 +180,7 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -209,18 +209,21 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else 
         {
           *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
 
 /* Loads page directory PD into the CPU's page directory base
-   register. */
+   register, unless it is already loaded.  Reloading it would
+   flush the TLB's user mappings for nothing. */
 void
 pagedir_activate (uint32_t *pd) 
 {
   if (pd == NULL)
     pd = init_page_dir;
+  if (pd == active_pd ())
+    return;
 
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
@@ -243,21 +246,23 @@ active_pd (void)
   return ptov (pd);
 }
 
-/* Seom page table changes can cause the CPU's translation
+/* Some page table changes can cause the CPU's translation
    lookaside buffer (TLB) to become out-of-sync with the page
-   table.  When this happens, we have to "invalidate" the TLB by
-   re-activating it.
+   table.  When this happens, we have to "invalidate" the stale
+   entry.
 
-   This function invalidates the TLB if PD is the active page
-   directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+   This function invalidates the TLB entry for VADDR if PD is the
+   active page directory.  (If PD is not active then none of its
+   user entries are in the TLB, because loading another page
+   directory flushed them, so there is no need to invalidate
+   anything.) */
 static void
-invalidate_pagedir (uint32_t *pd) 
+invalidate_page (uint32_t *pd, const void *vaddr) 
 {
   if (active_pd () == pd) 
     {
-      /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
-         "Translation Lookaside Buffers (TLBs)". */
-      pagedir_activate (pd);
+      /* Flushing just VADDR's entry keeps the rest of the TLB.
+         See [IA32-v2a] "INVLPG--Invalidate TLB Entry". */
+      asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
     } 
 }
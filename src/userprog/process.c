@@ -7,51 +7,100 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
+#include "userprog/usermem.h"
+#include "devices/timer.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
+
+/* Statistics. */
+static long long exec_cnt;      /* Number of executables loaded. */
+static long long exec_usecs;    /* Total microseconds spent loading. */
+
+/* A process's completion status, shared between the process
+   and its parent, so that the parent can wait for the process
+   even after it has exited.  Freed when both have let go of it. */
+struct wait_status
+  {
+    struct list_elem elem;      /* Element in parent's `children'. */
+    struct lock lock;           /* Protects REF_CNT. */
+    int ref_cnt;                /* 2 = both alive, 1 = one alive, 0 = free. */
+    tid_t tid;                  /* Child thread id. */
+    int exit_code;              /* Child exit code, if dead. */
+    struct semaphore dead;      /* Upped when the child dies. */
+  };
+
+/* Passed from process_execute() to start_process(). */
+struct exec_info
+  {
+    const char *cmd_line;       /* Program to load and its arguments. */
+    struct semaphore loaded;    /* Upped when loading is complete. */
+    struct wait_status *wait_status; /* Child's status, if loaded. */
+  };
 
 static thread_func start_process NO_RETURN;
-static bool load (const char *cmdline, void (**eip) (void), void **esp);
+static bool load (const char *cmd_line, void (**eip) (void), void **esp);
+static void release_wait_status (struct wait_status *);
 
 /* Starts a new thread running a user program loaded from
-   FILENAME.  The new thread may be scheduled (and may even exit)
-   before process_execute() returns.  Returns the new process's
-   thread id, or TID_ERROR if the thread cannot be created. */
+   CMD_LINE, which consists of the program's name followed by
+   its arguments, separated by spaces.  Waits for the program to
+   load.  Returns the new process's thread id, or TID_ERROR if
+   the thread cannot be created or the program cannot be
+   loaded. */
 tid_t
-process_execute (const char *file_name) 
+process_execute (const char *cmd_line) 
 {
-  char *fn_copy;
+  struct exec_info exec;
+  char thread_name[16];
+  char *save_ptr;
   tid_t tid;
 
-  /* Make a copy of FILE_NAME.
-     Otherwise there's a race between the caller and load(). */
-  fn_copy = palloc_get_page (0);
-  if (fn_copy == NULL)
+  /* Name the thread after the program. */
+  while (*cmd_line == ' ')
+    cmd_line++;
+  strlcpy (thread_name, cmd_line, sizeof thread_name);
+  strtok_r (thread_name, " ", &save_ptr);
+
+  /* Create a new thread to execute CMD_LINE, and wait for it to
+     load.  CMD_LINE and EXEC stay valid until it has. */
+  exec.cmd_line = cmd_line;
+  sema_init (&exec.loaded, 0);
+  exec.wait_status = NULL;
+  tid = thread_create (thread_name, PRI_DEFAULT, start_process, &exec);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+  sema_down (&exec.loaded);
+  if (exec.wait_status == NULL)
     return TID_ERROR;
-  strlcpy (fn_copy, file_name, PGSIZE);
 
-  /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (file_name, PRI_DEFAULT, start_process, fn_copy);
-  if (tid == TID_ERROR)
-    palloc_free_page (fn_copy); 
+  list_push_back (&thread_current ()->children, &exec.wait_status->elem);
   return tid;
 }
 
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process (void *file_name_)
+start_process (void *exec_)
 {
-  char *file_name = file_name_;
+  struct exec_info *exec = exec_;
+  struct thread *t = thread_current ();
   struct intr_frame if_;
+  int64_t start;
   bool success;
 
   /* Initialize interrupt frame and load executable. */
@@ -59,10 +108,38 @@ start_process (void *file_name_)
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
-  success = load (file_name, &if_.eip, &if_.esp);
+  start = timer_usecs ();
+  success = load (exec->cmd_line, &if_.eip, &if_.esp);
+  if (success)
+    {
+      enum intr_level old_level = intr_disable ();
+      exec_cnt++;
+      exec_usecs += timer_usecs_elapsed (start);
+      intr_set_level (old_level);
+    }
+
+  /* Allocate the status our parent will wait on. */
+  if (success)
+    {
+      struct wait_status *ws = malloc (sizeof *ws);
+      if (ws != NULL)
+        {
+          lock_init (&ws->lock);
+          ws->ref_cnt = 2;
+          ws->tid = t->tid;
+          ws->exit_code = -1;
+          sema_init (&ws->dead, 0);
+          t->wait_status = exec->wait_status = ws;
+        }
+      else
+        success = false;
+    }
+
+  /* Tell our parent how loading went.  EXEC is gone after
+     this. */
+  sema_up (&exec->loaded);
 
   /* If load failed, quit. */
-  palloc_free_page (file_name);
   if (!success) 
     thread_exit ();
 
@@ -76,18 +153,48 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+/* Releases one reference to WS and, if it is now unreferenced,
+   frees it. */
+static void
+release_wait_status (struct wait_status *ws) 
+{
+  int new_ref_cnt;
+  
+  lock_acquire (&ws->lock);
+  new_ref_cnt = --ws->ref_cnt;
+  lock_release (&ws->lock);
+
+  if (new_ref_cnt == 0)
+    free (ws);
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
    child of the calling process, or if process_wait() has already
    been successfully called for the given TID, returns -1
-   immediately, without waiting.
-
-   This function will be implemented in problem 2-2.  For now, it
-   does nothing. */
+   immediately, without waiting. */
 int
-process_wait (tid_t child_tid UNUSED) 
+process_wait (tid_t child_tid) 
 {
+  struct list *children = &thread_current ()->children;
+  struct list_elem *e;
+
+  for (e = list_begin (children); e != list_end (children);
+       e = list_next (e)) 
+    {
+      struct wait_status *ws = list_entry (e, struct wait_status, elem);
+      if (ws->tid == child_tid) 
+        {
+          int exit_code;
+
+          list_remove (e);
+          sema_down (&ws->dead);
+          exit_code = ws->exit_code;
+          release_wait_status (ws);
+          return exit_code;
+        }
+    }
   return -1;
 }
 
@@ -96,8 +203,21 @@ void
 process_exit (void)
 {
   struct thread *cur = thread_current ();
+  struct list_elem *e, *next;
   uint32_t *pd;
 
+  /* Close our files. */
+  syscall_exit ();
+
+  /* Let go of our children's statuses. */
+  for (e = list_begin (&cur->children); e != list_end (&cur->children);
+       e = next) 
+    {
+      struct wait_status *ws = list_entry (e, struct wait_status, elem);
+      next = list_remove (e);
+      release_wait_status (ws);
+    }
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -110,10 +230,36 @@ process_exit (void)
          directory before destroying the process's page
          directory, or our active page directory will be one
          that's been freed (and cleared). */
+#ifdef VM
+      mmap_table_destroy ();
+      page_table_destroy ();
+#endif
       cur->pagedir = NULL;
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }
+
+  /* Let the executable be written again. */
+  if (cur->executable != NULL)
+    {
+      file_close (cur->executable);
+      cur->executable = NULL;
+    }
+
+  /* Report our exit code to our parent, if we have one.  This
+     comes last, because the parent may run as soon as we signal
+     it, and by then our files must be closed, our memory-mapped
+     files written back, and our executable writable again. */
+  if (cur->wait_status != NULL) 
+    {
+      struct wait_status *ws = cur->wait_status;
+
+      printf ("%s: exit(%d)\n", cur->name, cur->exit_code);
+      ws->exit_code = cur->exit_code;
+      sema_up (&ws->dead);
+      release_wait_status (ws);
+      cur->wait_status = NULL;
+    }
 }
 
 /* Sets up the CPU for running user code in the current
@@ -124,13 +270,23 @@ process_activate (void)
 {
   struct thread *t = thread_current ();
 
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables.  A kernel thread uses only
+     kernel mappings, which every page directory has, so it runs
+     on whichever one is active instead of reloading CR3. */
+  if (t->pagedir != NULL)
+    pagedir_activate (t->pagedir);
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
   tss_update ();
 }
+
+/* Prints process statistics. */
+void
+process_print_stats (void) 
+{
+  printf ("Exec: %lld programs loaded in %lld us\n", exec_cnt, exec_usecs);
+}
 
 /* We load ELF binaries.  The following definitions are taken
    from the ELF specification, [ELF1], more-or-less verbatim.  */
@@ -195,30 +351,48 @@ struct Elf32_Phdr
 #define PF_W 2          /* Writable. */
 #define PF_R 4          /* Readable. */
 
-static bool setup_stack (void **esp);
+static bool setup_stack (const char *cmd_line, void **esp);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
                           bool writable);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
-   Stores the executable's entry point into *EIP
-   and its initial stack pointer into *ESP.
+/* Loads an ELF executable named by the first word of CMD_LINE
+   into the current thread, with the words of CMD_LINE as its
+   arguments.  Stores the executable's entry point into *EIP and
+   its initial stack pointer into *ESP.
    Returns true if successful, false otherwise. */
-bool
-load (const char *file_name, void (**eip) (void), void **esp) 
+static bool
+load (const char *cmd_line, void (**eip) (void), void **esp) 
 {
   struct thread *t = thread_current ();
+  char file_name[NAME_MAX + 2];
   struct Elf32_Ehdr ehdr;
   struct file *file = NULL;
   off_t file_ofs;
   bool success = false;
+  char *save_ptr;
   int i;
 
-  /* Allocate and activate page directory. */
+  /* Extract the file name.  One too long to be a file name is
+     truncated to one that is still too long, so it is not found. */
+  strlcpy (file_name, cmd_line, sizeof file_name);
+  strtok_r (file_name, " ", &save_ptr);
+
+  /* Allocate and activate page directory, and with virtual
+     memory, the supplemental page table that goes with it. */
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL) 
     goto done;
+#ifdef VM
+  if (!page_table_create ())
+    {
+      pagedir_destroy (t->pagedir);
+      t->pagedir = NULL;
+      goto done;
+    }
+  mmap_table_create ();
+#endif
   process_activate ();
 
   /* Open executable file. */
@@ -301,24 +475,32 @@ load (const char *file_name, void (**eip) (void), void **esp)
         }
     }
 
-  /* Set up stack. */
-  if (!setup_stack (esp))
-    goto done;
-
   /* Start address. */
   *eip = (void (*) (void)) ehdr.e_entry;
 
   success = true;
 
  done:
-  /* We arrive here whether the load is successful or not. */
-  file_close (file);
-  return success;
+  /* We arrive here whether the load is successful or not.  On
+     success the executable stays open, and unwritable, until the
+     process exits, since its pages may be read in lazily. */
+  if (success)
+    {
+      file_deny_write (file);
+      t->executable = file;
+    }
+  else
+    file_close (file);
+
+  /* Set up stack. */
+  return success && setup_stack (cmd_line, esp);
 }
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -377,6 +559,10 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With virtual memory, the pages are only recorded in the
+   supplemental page table here, and are read in when the
+   process first touches them.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -387,6 +573,21 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifdef VM
+  while (read_bytes > 0 || zero_bytes > 0) 
+    {
+      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+
+      if (page_add_file (upage, file, ofs, page_read_bytes, writable) == NULL)
+        return false;
+
+      read_bytes -= page_read_bytes;
+      zero_bytes -= PGSIZE - page_read_bytes;
+      ofs += page_read_bytes;
+      upage += PGSIZE;
+    }
+  return true;
+#else
   file_seek (file, ofs);
   while (read_bytes > 0 || zero_bytes > 0) 
     {
@@ -422,28 +623,110 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       upage += PGSIZE;
     }
   return true;
+#endif
+}
+
+/* Pushes the SIZE bytes in BUF onto the user stack whose
+   pointer is *ESP, keeping the stack word-aligned and within its
+   first page.  Returns the user address of the copy, or a null
+   pointer if there is no room or the stack cannot be written. */
+static void *
+push (uint8_t **esp, const void *buf, size_t size) 
+{
+  size_t padsize = ROUND_UP (size, sizeof (uint32_t));
+  uint8_t *bottom = (uint8_t *) PHYS_BASE - PGSIZE;
+
+  if (padsize > (size_t) (*esp - bottom))
+    return NULL;
+  *esp -= padsize;
+  if (!copy_to_user (*esp, buf, size))
+    return NULL;
+  return *esp;
+}
+
+/* Pushes the words of CMD_LINE onto the user stack whose pointer
+   is *ESP as the arguments to main(), followed by a null return
+   address.  Returns true if successful, false if they do not
+   fit. */
+static bool
+push_arguments (const char *cmd_line, uint8_t **esp) 
+{
+  const void *null = NULL;
+  char *words;
+  char *uwords;
+  char **argv;
+  size_t length, i;
+  int argc;
+  bool success = false;
+
+  /* Copy CMD_LINE, with each space replaced by a null, onto the
+     stack.  Each word then starts at a non-null byte that follows
+     a null byte or begins the string. */
+  words = palloc_get_page (0);
+  if (words == NULL)
+    return false;
+  length = strlcpy (words, cmd_line, PGSIZE);
+  if (length >= PGSIZE)
+    goto done;
+  for (i = 0; i < length; i++)
+    if (words[i] == ' ')
+      words[i] = '\0';
+  uwords = push (esp, words, length + 1);
+  if (uwords == NULL)
+    goto done;
+
+  /* Push argv[argc], then the address of each word, last word
+     first, so that argv[0] ends up on top. */
+  if (push (esp, &null, sizeof null) == NULL)
+    goto done;
+  argc = 0;
+  for (i = length; i-- > 0; )
+    if (words[i] != '\0' && (i == 0 || words[i - 1] == '\0'))
+      {
+        char *uarg = uwords + i;
+        if (push (esp, &uarg, sizeof uarg) == NULL)
+          goto done;
+        argc++;
+      }
+
+  /* Push argv, argc, and a null return address. */
+  argv = (char **) *esp;
+  success = (push (esp, &argv, sizeof argv) != NULL
+             && push (esp, &argc, sizeof argc) != NULL
+             && push (esp, &null, sizeof null) != NULL);
+
+ done:
+  palloc_free_page (words);
+  return success;
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+   user virtual memory, then push CMD_LINE's words onto it as the
+   arguments to main().  With virtual memory, the page is zeroed
+   and mapped when the arguments are first pushed onto it. */
 static bool
-setup_stack (void **esp) 
+setup_stack (const char *cmd_line, void **esp) 
 {
+#ifdef VM
+  if (page_add_zero (((uint8_t *) PHYS_BASE) - PGSIZE, true) == NULL)
+    return false;
+#else
   uint8_t *kpage;
-  bool success = false;
 
   kpage = palloc_get_page (PAL_USER | PAL_ZERO);
-  if (kpage != NULL) 
+  if (kpage == NULL)
+    return false;
+  if (!install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true))
     {
-      success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
-      if (success)
-        *esp = PHYS_BASE;
-      else
-        palloc_free_page (kpage);
+      palloc_free_page (kpage);
+      return false;
     }
-  return success;
+#endif
+  *esp = PHYS_BASE;
+  return push_arguments (cmd_line, (uint8_t **) esp);
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -463,3 +746,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
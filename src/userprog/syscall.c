@@ -1,20 +1,706 @@
 #include "userprog/syscall.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <limits.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include <uio.h>
+#include "userprog/process.h"
+#include "userprog/usermem.h"
+#include "devices/input.h"
+#include "devices/shutdown.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/mmap.h"
+#endif
+
+/* File descriptors.
+
+   A process's open files are kept in FD_TABLE, an array indexed
+   by file handle, so looking one up is a single array access.
+   FD_MAP marks the handles in use, so that the lowest free handle
+   is found by scanning the map a word at a time.  Both grow by
+   doubling when every handle is taken, starting from
+   FD_MIN_CNT.  Handles 0 and 1 are the console; they are always
+   marked in use and their FD_TABLE entries are null. */
+#define FD_MIN_CNT 16
+
+/* A system call handler.  ARGS holds the call's arguments, as
+   copied from the user stack. */
+typedef int syscall_function (const uint32_t args[]);
+
+static syscall_function sys_halt;
+static syscall_function sys_exit;
+static syscall_function sys_exec;
+static syscall_function sys_wait;
+static syscall_function sys_create;
+static syscall_function sys_remove;
+static syscall_function sys_open;
+static syscall_function sys_filesize;
+static syscall_function sys_read;
+static syscall_function sys_write;
+static syscall_function sys_seek;
+static syscall_function sys_tell;
+static syscall_function sys_close;
+#ifdef VM
+static syscall_function sys_mmap;
+static syscall_function sys_munmap;
+#endif
+static syscall_function sys_readv;
+static syscall_function sys_writev;
+static syscall_function sys_io_ring_enter;
+
+/* A system call. */
+struct syscall
+  {
+    size_t arg_cnt;             /* Number of arguments. */
+    syscall_function *func;     /* Implementation. */
+  };
+
+/* Table of system calls, indexed by system call number.  Calls
+   without an entry kill the process that makes them. */
+static const struct syscall syscall_table[] =
+  {
+    [SYS_HALT] = {0, sys_halt},
+    [SYS_EXIT] = {1, sys_exit},
+    [SYS_EXEC] = {1, sys_exec},
+    [SYS_WAIT] = {1, sys_wait},
+    [SYS_CREATE] = {2, sys_create},
+    [SYS_REMOVE] = {1, sys_remove},
+    [SYS_OPEN] = {1, sys_open},
+    [SYS_FILESIZE] = {1, sys_filesize},
+    [SYS_READ] = {3, sys_read},
+    [SYS_WRITE] = {3, sys_write},
+    [SYS_SEEK] = {2, sys_seek},
+    [SYS_TELL] = {1, sys_tell},
+    [SYS_CLOSE] = {1, sys_close},
+#ifdef VM
+    [SYS_MMAP] = {2, sys_mmap},
+    [SYS_MUNMAP] = {1, sys_munmap},
+#endif
+    [SYS_READV] = {3, sys_readv},
+    [SYS_WRITEV] = {3, sys_writev},
+    [SYS_IO_RING_ENTER] = {1, sys_io_ring_enter},
+  };
 
 static void syscall_handler (struct intr_frame *);
+static const struct syscall *lookup_syscall (unsigned call_nr);
+static struct file *find_fd (int handle);
+static struct file *lookup_fd (int handle);
+static int alloc_fd (struct file *);
 
 void
-syscall_init (void) 
+syscall_init (void)
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
+/* Handler for system calls made with `int $0x30', which pass
+   the call number and then its arguments on the user stack. */
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+syscall_handler (struct intr_frame *f)
+{
+  const struct syscall *sc;
+  unsigned call_nr;
+  uint32_t args[3];
+
+#ifdef VM
+  /* Page faults in the kernel on the process's behalf grow the
+     stack relative to the process's stack pointer. */
+  thread_current ()->user_esp = f->esp;
+#endif
+
+  /* Get the system call. */
+  if (!copy_from_user (&call_nr, f->esp, sizeof call_nr))
+    thread_exit ();
+  sc = lookup_syscall (call_nr);
+
+  /* Get the system call arguments. */
+  ASSERT (sc->arg_cnt <= sizeof args / sizeof *args);
+  memset (args, 0, sizeof args);
+  if (!copy_from_user (args, (uint32_t *) f->esp + 1,
+                       sizeof *args * sc->arg_cnt))
+    thread_exit ();
+
+  /* Execute the system call, and set the return value. */
+  f->eax = sc->func (args);
+}
+
+/* Handler for system calls made with SYSENTER, called from
+   sysenter_entry in userprog/sysenter.S.  The call number and
+   arguments were passed in registers, so nothing needs to be
+   read from the user stack.  USER_ESP is the process's stack
+   pointer.  Returns the system call's return value. */
+int
+syscall_sysenter (unsigned call_nr, const uint32_t args[3],
+                  void *user_esp UNUSED)
+{
+  const struct syscall *sc;
+
+#ifdef VM
+  thread_current ()->user_esp = user_esp;
+#endif
+
+  sc = lookup_syscall (call_nr);
+  return sc->func (args);
+}
+
+/* Returns system call CALL_NR, or kills the process if there is
+   no such call. */
+static const struct syscall *
+lookup_syscall (unsigned call_nr)
 {
-  printf ("system call!\n");
+  if (call_nr >= sizeof syscall_table / sizeof *syscall_table
+      || syscall_table[call_nr].func == NULL)
+    thread_exit ();
+  return syscall_table + call_nr;
+}
+
+/* Copies user string USTR into a new kernel page and returns it,
+   or kills the process if USTR is not valid. */
+static char *
+copy_in_string (const char *ustr)
+{
+  char *ks = copy_string_from_user (ustr);
+  if (ks == NULL)
+    thread_exit ();
+  return ks;
+}
+
+/* Halt system call. */
+static int
+sys_halt (const uint32_t args[] UNUSED)
+{
+  shutdown_power_off ();
+}
+
+/* Exit system call. */
+static int
+sys_exit (const uint32_t args[])
+{
+  int exit_code = args[0];
+
+  thread_current ()->exit_code = exit_code;
   thread_exit ();
+  NOT_REACHED ();
+}
+
+/* Exec system call. */
+static int
+sys_exec (const uint32_t args[])
+{
+  char *kcmd_line = copy_in_string ((const char *) args[0]);
+  tid_t tid = process_execute (kcmd_line);
+
+  palloc_free_page (kcmd_line);
+  return tid;
+}
+
+/* Wait system call. */
+static int
+sys_wait (const uint32_t args[])
+{
+  return process_wait (args[0]);
+}
+
+/* Create system call. */
+static int
+sys_create (const uint32_t args[])
+{
+  char *kfile = copy_in_string ((const char *) args[0]);
+  unsigned initial_size = args[1];
+  bool ok;
+
+  ok = filesys_create (kfile, initial_size);
+  palloc_free_page (kfile);
+  return ok;
+}
+
+/* Remove system call. */
+static int
+sys_remove (const uint32_t args[])
+{
+  char *kfile = copy_in_string ((const char *) args[0]);
+  bool ok;
+
+  ok = filesys_remove (kfile);
+  palloc_free_page (kfile);
+  return ok;
+}
+
+/* Open system call. */
+static int
+sys_open (const uint32_t args[])
+{
+  char *kfile = copy_in_string ((const char *) args[0]);
+  struct file *file;
+  int handle = -1;
+
+  file = filesys_open (kfile);
+  if (file != NULL)
+    {
+      handle = alloc_fd (file);
+      if (handle < 0)
+        file_close (file);
+    }
+
+  palloc_free_page (kfile);
+  return handle;
+}
+
+/* Doubles the size of thread T's file descriptor table, or
+   creates it if T has none.  Must only be called when every
+   handle in the table is in use.  Returns true if successful,
+   false if memory is exhausted. */
+static bool
+grow_fd_table (struct thread *t)
+{
+  size_t new_cnt = t->fd_cnt > 0 ? t->fd_cnt * 2 : FD_MIN_CNT;
+  struct file **table;
+  struct bitmap *map;
+
+  if (new_cnt > INT_MAX)
+    return false;
+  table = realloc (t->fd_table, new_cnt * sizeof *table);
+  if (table == NULL)
+    return false;
+  t->fd_table = table;
+  map = bitmap_create (new_cnt);
+  if (map == NULL)
+    return false;
+
+  memset (table + t->fd_cnt, 0, (new_cnt - t->fd_cnt) * sizeof *table);
+  bitmap_set_multiple (map, 0, t->fd_cnt > 0 ? t->fd_cnt : 2, true);
+  if (t->fd_map != NULL)
+    bitmap_destroy (t->fd_map);
+  t->fd_map = map;
+  t->fd_cnt = new_cnt;
+  return true;
+}
+
+/* Binds FILE to the lowest free file handle in the current
+   process and returns the handle, or -1 if memory is
+   exhausted. */
+static int
+alloc_fd (struct file *file)
+{
+  struct thread *cur = thread_current ();
+  size_t handle = BITMAP_ERROR;
+
+  if (cur->fd_map != NULL)
+    handle = bitmap_scan_and_flip (cur->fd_map, 0, 1, false);
+  if (handle == BITMAP_ERROR)
+    {
+      if (!grow_fd_table (cur))
+        return -1;
+      handle = bitmap_scan_and_flip (cur->fd_map, 0, 1, false);
+    }
+  cur->fd_table[handle] = file;
+  return handle;
+}
+
+/* Returns the file associated with the given handle, or a null
+   pointer if HANDLE is not associated with an open file. */
+static struct file *
+find_fd (int handle)
+{
+  struct thread *cur = thread_current ();
+
+  if (handle >= 0 && (size_t) handle < cur->fd_cnt)
+    return cur->fd_table[handle];
+  return NULL;
+}
+
+/* Returns the file associated with the given handle.  Terminates
+   the process if HANDLE is not associated with an open file. */
+static struct file *
+lookup_fd (int handle)
+{
+  struct file *file = find_fd (handle);
+
+  if (file == NULL)
+    thread_exit ();
+  return file;
+}
+
+/* Filesize system call. */
+static int
+sys_filesize (const uint32_t args[])
+{
+  struct file *file = lookup_fd (args[0]);
+
+  return file_length (file);
+}
+
+/* Reads SIZE bytes into user buffer UDST from FILE, or from the
+   keyboard if FILE is null, starting at offset OFS in the file or,
+   if OFS is negative, at the file's position, which is advanced.
+   Data is read a page at a time into kernel page BUFFER, then
+   copied out to the process, so that no inode lock is held
+   while the process's memory might fault: paging in part of a
+   mapped file could need the same lock.  Returns the number of
+   bytes read, or -1 if UDST is not writable user memory. */
+static int
+read_to_user (struct file *file, uint8_t *udst, unsigned size,
+              off_t ofs, uint8_t *buffer)
+{
+  int bytes_read = 0;
+
+  if (!is_user_range (udst, size))
+    return -1;
+  while (size > 0)
+    {
+      size_t chunk = size < PGSIZE ? size : PGSIZE;
+      off_t retval;
+
+      if (file != NULL)
+        retval = (ofs < 0
+                  ? file_read (file, buffer, chunk)
+                  : file_read_at (file, buffer, chunk, ofs + bytes_read));
+      else
+        {
+          for (retval = 0; (size_t) retval < chunk; retval++)
+            buffer[retval] = input_getc ();
+        }
+
+      if (retval > 0 && !copy_to_user (udst, buffer, retval))
+        return -1;
+      bytes_read += retval;
+      if (retval != (off_t) chunk)
+        break;
+
+      udst += chunk;
+      size -= chunk;
+    }
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from user buffer USRC to FILE, or to the
+   console if FILE is null, starting at offset OFS in the file or,
+   if OFS is negative, at the file's position, which is advanced.
+   Data is copied in a page at a time to kernel page BUFFER, then
+   written from there.  Returns the number of bytes written, or
+   -1 if USRC is not readable user memory. */
+static int
+write_from_user (struct file *file, const uint8_t *usrc,
+                 unsigned size, off_t ofs, uint8_t *buffer)
+{
+  int bytes_written = 0;
+
+  if (!is_user_range (usrc, size))
+    return -1;
+  while (size > 0)
+    {
+      size_t chunk = size < PGSIZE ? size : PGSIZE;
+      off_t retval;
+
+      if (!copy_from_user (buffer, usrc, chunk))
+        return -1;
+
+      if (file != NULL)
+        retval = (ofs < 0
+                  ? file_write (file, buffer, chunk)
+                  : file_write_at (file, buffer, chunk,
+                                   ofs + bytes_written));
+      else
+        {
+          putbuf ((char *) buffer, chunk);
+          retval = chunk;
+        }
+      bytes_written += retval;
+      if (retval != (off_t) chunk)
+        break;
+
+      usrc += chunk;
+      size -= chunk;
+    }
+  return bytes_written;
+}
+
+/* Read system call. */
+static int
+sys_read (const uint32_t args[])
+{
+  int handle = args[0];
+  uint8_t *udst = (uint8_t *) args[1];
+  unsigned size = args[2];
+  struct file *file;
+  uint8_t *buffer;
+  int bytes_read;
+
+  file = handle != STDIN_FILENO ? lookup_fd (handle) : NULL;
+  if (size == 0)
+    return 0;
+  buffer = palloc_get_page (0);
+  if (buffer == NULL)
+    return -1;
+  bytes_read = read_to_user (file, udst, size, -1, buffer);
+  palloc_free_page (buffer);
+
+  if (bytes_read < 0)
+    thread_exit ();
+  return bytes_read;
+}
+
+/* Write system call. */
+static int
+sys_write (const uint32_t args[])
+{
+  int handle = args[0];
+  const uint8_t *usrc = (const uint8_t *) args[1];
+  unsigned size = args[2];
+  struct file *file;
+  uint8_t *buffer;
+  int bytes_written;
+
+  file = handle != STDOUT_FILENO ? lookup_fd (handle) : NULL;
+  if (size == 0)
+    return 0;
+  buffer = palloc_get_page (0);
+  if (buffer == NULL)
+    return -1;
+  bytes_written = write_from_user (file, usrc, size, -1, buffer);
+  palloc_free_page (buffer);
+
+  if (bytes_written < 0)
+    thread_exit ();
+  return bytes_written;
+}
+
+/* Copies the ARGS[2] buffers at user address ARGS[1], an array
+   of struct iovec, into IOV.  Kills the process if there are too
+   many or they cannot be read.  Returns the number of buffers. */
+static int
+copy_in_iovec (const uint32_t args[], struct iovec iov[IOV_MAX])
+{
+  int iovcnt = args[2];
+
+  if (iovcnt < 0 || iovcnt > IOV_MAX
+      || !copy_from_user (iov, (const void *) args[1],
+                          sizeof *iov * iovcnt))
+    thread_exit ();
+  return iovcnt;
+}
+
+/* Readv system call. */
+static int
+sys_readv (const uint32_t args[])
+{
+  int handle = args[0];
+  struct iovec iov[IOV_MAX];
+  int iovcnt = copy_in_iovec (args, iov);
+  struct file *file;
+  uint8_t *buffer;
+  int bytes_read = 0;
+  int i;
+
+  file = handle != STDIN_FILENO ? lookup_fd (handle) : NULL;
+  buffer = palloc_get_page (0);
+  if (buffer == NULL)
+    return -1;
+  for (i = 0; i < iovcnt; i++)
+    {
+      int retval = read_to_user (file, iov[i].iov_base, iov[i].iov_len,
+                                 -1, buffer);
+      if (retval < 0)
+        {
+          palloc_free_page (buffer);
+          thread_exit ();
+        }
+      bytes_read += retval;
+      if ((size_t) retval != iov[i].iov_len)
+        break;
+    }
+  palloc_free_page (buffer);
+  return bytes_read;
+}
+
+/* Writev system call. */
+static int
+sys_writev (const uint32_t args[])
+{
+  int handle = args[0];
+  struct iovec iov[IOV_MAX];
+  int iovcnt = copy_in_iovec (args, iov);
+  struct file *file;
+  uint8_t *buffer;
+  int bytes_written = 0;
+  int i;
+
+  file = handle != STDOUT_FILENO ? lookup_fd (handle) : NULL;
+  buffer = palloc_get_page (0);
+  if (buffer == NULL)
+    return -1;
+  for (i = 0; i < iovcnt; i++)
+    {
+      int retval = write_from_user (file, iov[i].iov_base, iov[i].iov_len,
+                                    -1, buffer);
+      if (retval < 0)
+        {
+          palloc_free_page (buffer);
+          thread_exit ();
+        }
+      bytes_written += retval;
+      if ((size_t) retval != iov[i].iov_len)
+        break;
+    }
+  palloc_free_page (buffer);
+  return bytes_written;
+}
+
+/* Carries out submission SQE and returns its result: the number
+   of bytes transferred, or -1 on failure.  Unlike read() and
+   write(), a bad file descriptor or buffer fails just the one
+   operation instead of killing the process. */
+static int
+do_submission (const struct io_sqe *sqe, uint8_t *buffer)
+{
+  struct file *file = NULL;
+
+  if (sqe->ofs < -1)
+    return -1;
+  switch (sqe->op)
+    {
+    case IO_READ:
+      if (sqe->fd != STDIN_FILENO && (file = find_fd (sqe->fd)) == NULL)
+        return -1;
+      return read_to_user (file, sqe->buf, sqe->len, sqe->ofs, buffer);
+
+    case IO_WRITE:
+      if (sqe->fd != STDOUT_FILENO && (file = find_fd (sqe->fd)) == NULL)
+        return -1;
+      return write_from_user (file, sqe->buf, sqe->len, sqe->ofs, buffer);
+
+    default:
+      return -1;
+    }
+}
+
+/* Io_ring_enter system call.  Carries out every submission
+   queued in the ring at user address ARGS[0], as long as there is
+   room for its completion, and returns the number carried out.
+   One kernel buffer serves the whole batch. */
+static int
+sys_io_ring_enter (const uint32_t args[])
+{
+  struct io_ring *uring = (struct io_ring *) args[0];
+  unsigned head[4];             /* sq_head, sq_tail, cq_head, cq_tail. */
+  unsigned sq_head, sq_tail, cq_head, cq_tail;
+  uint8_t *buffer;
+  int cnt = 0;
+
+  if (!copy_from_user (head, uring, sizeof head))
+    thread_exit ();
+  sq_head = head[0];
+  sq_tail = head[1];
+  cq_head = head[2];
+  cq_tail = head[3];
+  if (sq_tail - sq_head > IO_RING_SIZE || cq_tail - cq_head > IO_RING_SIZE)
+    return -1;
+
+  buffer = palloc_get_page (0);
+  if (buffer == NULL)
+    return -1;
+  while (sq_head != sq_tail && cq_tail - cq_head < IO_RING_SIZE)
+    {
+      struct io_sqe sqe;
+      struct io_cqe cqe;
+
+      if (!copy_from_user (&sqe, &uring->sq[sq_head % IO_RING_SIZE],
+                           sizeof sqe))
+        break;
+      cqe.user_data = sqe.user_data;
+      cqe.result = do_submission (&sqe, buffer);
+      if (!copy_to_user (&uring->cq[cq_tail % IO_RING_SIZE], &cqe,
+                         sizeof cqe))
+        break;
+      sq_head++;
+      cq_tail++;
+      cnt++;
+    }
+  palloc_free_page (buffer);
+
+  if (!copy_to_user (&uring->sq_head, &sq_head, sizeof sq_head)
+      || !copy_to_user (&uring->cq_tail, &cq_tail, sizeof cq_tail))
+    thread_exit ();
+  return cnt;
+}
+
+/* Seek system call. */
+static int
+sys_seek (const uint32_t args[])
+{
+  struct file *file = lookup_fd (args[0]);
+  unsigned position = args[1];
+
+  if ((off_t) position >= 0)
+    file_seek (file, position);
+  return 0;
+}
+
+/* Tell system call. */
+static int
+sys_tell (const uint32_t args[])
+{
+  struct file *file = lookup_fd (args[0]);
+
+  return file_tell (file);
+}
+
+/* Close system call. */
+static int
+sys_close (const uint32_t args[])
+{
+  int handle = args[0];
+  struct thread *cur = thread_current ();
+  struct file *file = lookup_fd (handle);
+
+  cur->fd_table[handle] = NULL;
+  bitmap_reset (cur->fd_map, handle);
+  file_close (file);
+  return 0;
+}
+
+#ifdef VM
+/* Mmap system call. */
+static int
+sys_mmap (const uint32_t args[])
+{
+  struct file *file = lookup_fd (args[0]);
+
+  return mmap_map (file, (void *) args[1]);
+}
+
+/* Munmap system call. */
+static int
+sys_munmap (const uint32_t args[])
+{
+  mmap_unmap (args[0]);
+  return 0;
+}
+#endif
+
+/* On thread exit, close all open files. */
+void
+syscall_exit (void)
+{
+  struct thread *cur = thread_current ();
+  size_t handle;
+
+  for (handle = 0; handle < cur->fd_cnt; handle++)
+    file_close (cur->fd_table[handle]);
+  free (cur->fd_table);
+  if (cur->fd_map != NULL)
+    bitmap_destroy (cur->fd_map);
+  cur->fd_table = NULL;
+  cur->fd_map = NULL;
+  cur->fd_cnt = 0;
 }
@@ -1,6 +1,11 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include <stdint.h>
+
 void syscall_init (void);
+int syscall_sysenter (unsigned call_nr, const uint32_t args[3],
+                      void *user_esp);
+void syscall_exit (void);
 
 #endif /* userprog/syscall.h */
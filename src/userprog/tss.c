@@ -1,5 +1,6 @@
 #include "userprog/tss.h"
 #include <debug.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
 #include "threads/thread.h"
@@ -75,6 +76,25 @@ struct tss
 /* Kernel TSS. */
 static struct tss *tss;
 
+/* Model-specific registers for SYSENTER.  See [IA32-v3b]
+   Appendix B "Model-Specific Registers (MSRs)". */
+#define MSR_SYSENTER_CS  0x174  /* Kernel code selector. */
+#define MSR_SYSENTER_ESP 0x175  /* Kernel stack pointer. */
+#define MSR_SYSENTER_EIP 0x176  /* Kernel entry point. */
+
+/* Stack that SYSENTER switches to.  Its top word always holds a
+   copy of the TSS's esp0, which sysenter_entry loads into %esp
+   with its first instruction.  Nothing else runs on it, except
+   the debug trap that a process single-stepping into SYSENTER
+   takes right on that instruction (see debug_exception() in
+   userprog/exception.c).  SYSENTER does not clear the trap
+   flag. */
+#define SYSENTER_STACK_WORDS 256
+static uint32_t sysenter_stack[SYSENTER_STACK_WORDS];
+
+static bool cpu_has_sysenter (void);
+static void wrmsr (uint32_t msr, uint32_t value);
+
 /* Initializes the kernel TSS. */
 void
 tss_init (void) 
@@ -86,6 +106,23 @@ tss_init (void)
   tss->ss0 = SEL_KDSEG;
   tss->bitmap = 0xdfff;
   tss_update ();
+
+  /* Set up SYSENTER, the fast system call entry, if the CPU has
+     it.  Its stack pointer points to the top of sysenter_stack,
+     from which sysenter_entry (in userprog/sysenter.S) loads the
+     running thread's kernel stack, so that it never has to
+     change.
+     SYSENTER and SYSEXIT derive the other selectors from
+     SEL_KCSEG, so gdt_init() must lay out the GDT to match. */
+  if (cpu_has_sysenter ())
+    {
+      extern char sysenter_entry[];
+
+      wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+      wrmsr (MSR_SYSENTER_ESP,
+             (uint32_t) &sysenter_stack[SYSENTER_STACK_WORDS - 1]);
+      wrmsr (MSR_SYSENTER_EIP, (uint32_t) sysenter_entry);
+    }
 }
 
 /* Returns the kernel TSS. */
@@ -96,11 +133,38 @@ tss_get (void)
   return tss;
 }
 
-/* Sets the ring 0 stack pointer in the TSS to point to the end
-   of the thread stack. */
+/* Sets the ring 0 stack pointer in the TSS, and its copy for
+   SYSENTER, to point to the end of the thread stack. */
 void
 tss_update (void) 
 {
   ASSERT (tss != NULL);
   tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
+  sysenter_stack[SYSENTER_STACK_WORDS - 1] = (uint32_t) tss->esp0;
+}
+
+/* Returns true if the CPU supports SYSENTER and SYSEXIT.  Early
+   Pentium Pro processors claim to but do not.  See [IA32-v3a]
+   5.8.7 "Performing Fast Calls to System Procedures with the
+   SYSENTER and SYSEXIT Instructions". */
+static bool
+cpu_has_sysenter (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  unsigned family, model, stepping;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+  return ((edx & (1 << 11)) != 0
+          && !(family == 6 && model < 3 && stepping < 3));
+}
+
+/* Writes VALUE to model-specific register MSR.  See [IA32-v2b]
+   "WRMSR--Write to Model Specific Register". */
+static void
+wrmsr (uint32_t msr, uint32_t value)
+{
+  asm volatile ("wrmsr" : : "c" (msr), "a" (value), "d" (0));
 }
@@ -0,0 +1,149 @@
+#include "userprog/usermem.h"
+#include <stdint.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Access to user memory from the kernel.
+
+   Rather than checking each user page in the page table before
+   touching it, these functions just access user memory and let
+   the MMU check it.  Each instruction that accesses user memory
+   is listed, along with the address to resume at if it faults,
+   in the fixup table in section .usermem_fixup.  Before the
+   access, %eax is loaded with a nonzero value.  When the kernel
+   faults on a user address at an instruction in the table,
+   page_fault() (in userprog/exception.c) jumps to its resume
+   address with %eax set to 0, which the function reports as
+   failure.  A kernel fault anywhere else is a kernel bug.  Under
+   virtual memory, a fault on a page that is merely not in memory
+   yet is resolved first, and the access is retried.
+
+   Kernel addresses are always accessible to the kernel, so the
+   functions also check that the whole range lies below
+   PHYS_BASE.
+
+   See [IA32-v3a] 5.15 "Interrupt 14--Page Fault Exception
+   (#PF)". */
+
+/* An entry in the fixup table. */
+struct usermem_fixup
+  {
+    uintptr_t insn;             /* Instruction that may fault. */
+    uintptr_t resume;           /* Where to go if it does. */
+  };
+
+/* Start and end of the fixup table, defined by the kernel's
+   linker script. */
+extern const struct usermem_fixup usermem_fixup_start[];
+extern const struct usermem_fixup usermem_fixup_end[];
+
+/* Emits a fixup table entry for the instruction at local label
+   0, to resume at local label 1. */
+#define USERMEM_FIXUP                           \
+  ".pushsection .usermem_fixup, \"a\"\n"         \
+  ".long 0b, 1b\n"                              \
+  ".popsection\n"
+
+/* Reads a byte at user virtual address USRC into *DST, which
+   must be a kernel address.  Returns true if successful, false
+   if a page fault occurred. */
+static inline bool
+get_user (uint8_t *dst, const uint8_t *usrc)
+{
+  int eax;
+  asm ("movl $1f, %%eax; 0: movb %2, %%al; movb %%al, %0; 1:\n"
+       USERMEM_FIXUP
+       : "=m" (*dst), "=&a" (eax) : "m" (*usrc));
+  return eax != 0;
+}
+
+/* Copies SIZE bytes from SRC to DST, either of which may be a
+   user address.  Returns true if successful, false if a page
+   fault occurred. */
+static inline bool
+copy_bytes (void *dst, const void *src, size_t size)
+{
+  int eax;
+  asm volatile ("movl $1f, %%eax; 0: rep movsb; 1:\n"
+                USERMEM_FIXUP
+                : "=&a" (eax), "+D" (dst), "+S" (src), "+c" (size)
+                : : "memory");
+  return eax != 0;
+}
+
+/* If EIP is an instruction in one of the functions above that
+   may fault on a user address, returns the address to resume at
+   after such a fault.  Otherwise, returns a null pointer. */
+void *
+usermem_fixup (const void *eip)
+{
+  const struct usermem_fixup *fx;
+
+  for (fx = usermem_fixup_start; fx < usermem_fixup_end; fx++)
+    if (fx->insn == (uintptr_t) eip)
+      return (void *) fx->resume;
+  return NULL;
+}
+
+/* Returns true if the SIZE bytes starting at UADDR all lie in
+   user virtual memory, false otherwise.  Says nothing about
+   whether they are mapped. */
+bool
+is_user_range (const void *uaddr, size_t size)
+{
+  uintptr_t start = (uintptr_t) uaddr;
+  uintptr_t end = (uintptr_t) PHYS_BASE;
+
+  return start < end && size <= end - start;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Returns true if successful, false if any byte of USRC is
+   not in mapped user memory. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  return size == 0 || (is_user_range (usrc, size)
+                       && copy_bytes (dst, usrc, size));
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Returns true if successful, false if any byte of UDST
+   is not in mapped, writable user memory. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  return size == 0 || (is_user_range (udst, size)
+                       && copy_bytes (udst, src, size));
+}
+
+/* Creates a copy of user string USTR in kernel memory and
+   returns it as a page that must be freed with
+   palloc_free_page().  Truncates the string at PGSIZE bytes in
+   size.  Returns a null pointer if USTR is not in mapped user
+   memory or if memory is exhausted. */
+char *
+copy_string_from_user (const char *ustr)
+{
+  char *ks;
+  size_t length;
+
+  ks = palloc_get_page (0);
+  if (ks == NULL)
+    return NULL;
+
+  for (length = 0; length < PGSIZE; length++)
+    {
+      if (!is_user_range (ustr + length, 1)
+          || !get_user ((uint8_t *) ks + length,
+                        (const uint8_t *) ustr + length))
+        {
+          palloc_free_page (ks);
+          return NULL;
+        }
+      if (ks[length] == '\0')
+        return ks;
+    }
+  ks[PGSIZE - 1] = '\0';
+  return ks;
+}
@@ -0,0 +1,13 @@
+#ifndef USERPROG_USERMEM_H
+#define USERPROG_USERMEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+bool is_user_range (const void *uaddr, size_t size);
+bool copy_from_user (void *dst, const void *usrc, size_t size);
+bool copy_to_user (void *udst, const void *src, size_t size);
+char *copy_string_from_user (const char *ustr);
+void *usermem_fixup (const void *eip);
+
+#endif /* userprog/usermem.h */
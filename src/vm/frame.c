@@ -0,0 +1,202 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+#include "vm/share.h"
+
+/* One frame per user pool page, indexed by page number within
+   the pool.  Frames are never freed, so a pointer to one stays
+   valid even after the page in it has been evicted. */
+static struct frame *frames;
+static size_t frame_cnt;
+
+/* Clock hand for eviction. */
+static struct lock scan_lock;   /* Protects HAND. */
+static size_t hand;
+
+/* Statistics. */
+static long long alloc_cnt;     /* Frames handed out. */
+static long long evict_cnt;     /* Frames obtained by eviction. */
+static size_t used_cnt;         /* Frames in use right now. */
+static size_t used_peak;        /* Most frames ever in use at once. */
+
+static struct frame *evict (void);
+static bool accessed_recently (struct frame *);
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  size_t i;
+
+  frame_cnt = palloc_user_page_cnt ();
+  frames = malloc (sizeof *frames * frame_cnt);
+  if (frames == NULL && frame_cnt > 0)
+    PANIC ("frame: could not allocate frame table");
+  for (i = 0; i < frame_cnt; i++)
+    {
+      lock_init (&frames[i].lock);
+      frames[i].kpage = NULL;
+      list_init (&frames[i].pages);
+      frames[i].inode = NULL;
+    }
+  lock_init (&scan_lock);
+}
+
+/* Obtains an empty frame, zeroed if ZERO is true, evicting a
+   page if the user pool is exhausted.  Returns the frame locked,
+   so that it is not evicted before the caller adds a page to it,
+   or a null pointer if no frame could be freed. */
+struct frame *
+frame_alloc (bool zero)
+{
+  void *kpage = palloc_get_page (PAL_USER | (zero ? PAL_ZERO : 0));
+  struct frame *f;
+  enum intr_level old_level;
+
+  if (kpage != NULL)
+    {
+      f = &frames[palloc_user_page_no (kpage)];
+      lock_acquire (&f->lock);
+      f->kpage = kpage;
+
+      old_level = intr_disable ();
+      if (++used_cnt > used_peak)
+        used_peak = used_cnt;
+      intr_set_level (old_level);
+    }
+  else
+    {
+      f = evict ();
+      if (f == NULL)
+        return NULL;
+      if (zero)
+        memset (f->kpage, 0, PGSIZE);
+    }
+
+  ASSERT (list_empty (&f->pages) && f->inode == NULL);
+  old_level = intr_disable ();
+  alloc_cnt++;
+  intr_set_level (old_level);
+  return f;
+}
+
+/* Frees frame F, which must be locked by the caller and have no
+   pages left in it, and returns its page to the user pool. */
+void
+frame_free (struct frame *f)
+{
+  enum intr_level old_level;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (list_empty (&f->pages) && f->inode == NULL);
+
+  palloc_free_page (f->kpage);
+  lock_release (&f->lock);
+
+  old_level = intr_disable ();
+  used_cnt--;
+  intr_set_level (old_level);
+}
+
+/* Locks the frame that holds page P, if it has one, so that it
+   cannot be evicted.  On return, P->frame is either null or a
+   frame locked by the current thread. */
+void
+frame_lock (struct page *p)
+{
+  struct frame *f = p->frame;
+
+  if (f != NULL)
+    {
+      lock_acquire (&f->lock);
+      if (f != p->frame)
+        {
+          /* P was evicted while we waited. */
+          lock_release (&f->lock);
+          ASSERT (p->frame == NULL);
+        }
+    }
+}
+
+/* Unlocks frame F, making it eligible for eviction again. */
+void
+frame_unlock (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  lock_release (&f->lock);
+}
+
+/* Chooses a frame with the clock algorithm, writes out the pages
+   in it, and returns it locked and empty.  Frames that are locked
+   or whose pages were accessed since the hand last passed are
+   skipped, the latter getting a second chance.  Returns a null
+   pointer if no frame can be evicted. */
+static struct frame *
+evict (void)
+{
+  enum intr_level old_level;
+  size_t i;
+
+  lock_acquire (&scan_lock);
+  for (i = 0; i < frame_cnt * 3; i++)
+    {
+      struct frame *f = &frames[hand];
+      if (++hand >= frame_cnt)
+        hand = 0;
+
+      if (lock_held_by_current_thread (&f->lock)
+          || !lock_try_acquire (&f->lock))
+        continue;
+      if (list_empty (&f->pages) || accessed_recently (f))
+        {
+          lock_release (&f->lock);
+          continue;
+        }
+
+      lock_release (&scan_lock);
+      if (f->inode != NULL
+          ? share_evict (f)
+          : page_out (list_entry (list_front (&f->pages),
+                                  struct page, frame_elem)))
+        {
+          old_level = intr_disable ();
+          evict_cnt++;
+          intr_set_level (old_level);
+          return f;
+        }
+      lock_release (&f->lock);
+      lock_acquire (&scan_lock);
+    }
+  lock_release (&scan_lock);
+  return NULL;
+}
+
+/* Returns true if any page in frame F was accessed since the
+   last call, and clears their accessed bits. */
+static bool
+accessed_recently (struct frame *f)
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (page_accessed_recently (list_entry (e, struct page, frame_elem)))
+      accessed = true;
+  return accessed;
+}
+
+/* Prints frame table statistics. */
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %zu user frames, %zu in use at peak, "
+          "%lld allocations, %lld evictions\n",
+          frame_cnt, used_peak, alloc_cnt, evict_cnt);
+}
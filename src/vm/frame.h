@@ -0,0 +1,42 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct page;
+
+/* A physical frame in the user pool.
+
+   A frame's lock is held whenever the frame is being filled or
+   emptied; the clock never evicts a locked frame.  PAGES changes
+   only while the lock is held.
+
+   Most frames hold one process's private page.  A frame holding
+   an unmodified page of a file may instead be mapped read-only
+   into several processes at once (see vm/share.c). */
+struct frame
+  {
+    struct lock lock;           /* Held while in use. */
+    void *kpage;                /* Kernel virtual address. */
+    struct list pages;          /* Pages mapped here; empty if free. */
+
+    /* Shared file pages only. */
+    struct hash_elem share_elem; /* Element in shared frame table. */
+    struct inode *inode;        /* Inode cached, or null if private. */
+    off_t ofs;                  /* Offset in INODE. */
+    size_t read_bytes;          /* Bytes read from INODE. */
+  };
+
+void frame_init (void);
+struct frame *frame_alloc (bool zero);
+void frame_free (struct frame *);
+void frame_lock (struct page *);
+void frame_unlock (struct frame *);
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
@@ -0,0 +1,186 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <stdio.h>
+#include "filesys/file.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* Most pages read ahead at one fault.  The read-ahead window
+   starts at one page when faults on a mapping become sequential
+   and doubles with each further sequential fault up to this
+   size. */
+#define MAX_READ_AHEAD 16
+
+/* Statistics. */
+static long long map_cnt;       /* Mappings created. */
+static long long ahead_cnt;     /* Pages read ahead. */
+
+static struct mapping *find_mapping (mapid_t);
+static void unmap (struct mapping *);
+
+/* Initializes the current process's table of memory mappings. */
+void
+mmap_table_create (void)
+{
+  struct thread *t = thread_current ();
+
+  list_init (&t->mappings);
+  t->next_mapid = 0;
+}
+
+/* Unmaps all of the current process's memory mappings, writing
+   modified pages back to their files.  Must be called before the
+   process's page table is destroyed. */
+void
+mmap_table_destroy (void)
+{
+  struct list *mappings = &thread_current ()->mappings;
+
+  while (!list_empty (mappings))
+    unmap (list_entry (list_front (mappings), struct mapping, elem));
+}
+
+/* Maps FILE into the current process's address space starting at
+   ADDR, which must be page-aligned, nonzero, and leave room for
+   the whole file without overlapping any page already in use.
+   The mapping holds its own reference to FILE, so it lasts even
+   if FILE is closed.  Pages are read in as they are first
+   touched.  Returns the new mapping's identifier, or MAP_FAILED
+   on failure. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  uint8_t *base = addr;
+  struct mapping *m;
+  off_t length;
+  enum intr_level old_level;
+  size_t i;
+
+  if (file == NULL || base == NULL || pg_ofs (base) != 0)
+    return MAP_FAILED;
+  length = file_length (file);
+  if (length <= 0)
+    return MAP_FAILED;
+
+  /* The range must lie entirely in unused user memory. */
+  if (!is_user_vaddr (base)
+      || (size_t) length > (size_t) ((uint8_t *) PHYS_BASE - base))
+    return MAP_FAILED;
+  for (i = 0; i < (size_t) length; i += PGSIZE)
+    if (page_lookup (base + i) != NULL)
+      return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  m->file = file_dup (file);
+  m->id = t->next_mapid++;
+  m->base = base;
+  m->page_cnt = 0;
+  m->next_fault = NULL;
+  m->window = 0;
+  list_push_back (&t->mappings, &m->elem);
+
+  for (i = 0; i < (size_t) length; i += PGSIZE)
+    {
+      size_t read_bytes = length - i < PGSIZE ? length - i : PGSIZE;
+      if (page_add_mmap (base + i, m, i, read_bytes) == NULL)
+        {
+          unmap (m);
+          return MAP_FAILED;
+        }
+      m->page_cnt++;
+    }
+  old_level = intr_disable ();
+  map_cnt++;
+  intr_set_level (old_level);
+  return m->id;
+}
+
+/* Unmaps the current process's mapping with identifier ID,
+   writing its modified pages back to the file.  Returns true if
+   successful, false if there is no such mapping. */
+bool
+mmap_unmap (mapid_t id)
+{
+  struct mapping *m = find_mapping (id);
+
+  if (m == NULL)
+    return false;
+  unmap (m);
+  return true;
+}
+
+/* Reads ahead in mapping M after a fault on UPAGE.  Once faults
+   arrive in order, each one brings in a window of following
+   pages, so that a process reading a mapped file from start to
+   end takes one fault per window rather than one per page. */
+void
+mmap_read_ahead (struct mapping *m, void *upage)
+{
+  uint8_t *end = m->base + m->page_cnt * PGSIZE;
+  uint8_t *next = (uint8_t *) upage + PGSIZE;
+  enum intr_level old_level;
+  size_t i;
+
+  if (upage == m->next_fault)
+    m->window = m->window == 0 ? 1 : m->window * 2;
+  else
+    m->window = 0;
+  if (m->window > MAX_READ_AHEAD)
+    m->window = MAX_READ_AHEAD;
+
+  for (i = 0; i < m->window && next < end; i++, next += PGSIZE)
+    {
+      if (!page_prefetch (next))
+        break;
+      old_level = intr_disable ();
+      ahead_cnt++;
+      intr_set_level (old_level);
+    }
+  m->next_fault = next;
+}
+
+/* Prints memory mapping statistics. */
+void
+mmap_print_stats (void)
+{
+  printf ("Mmap: %lld mappings, %lld pages read ahead\n",
+          map_cnt, ahead_cnt);
+}
+
+/* Returns the current process's mapping with identifier ID, or a
+   null pointer if there is none. */
+static struct mapping *
+find_mapping (mapid_t id)
+{
+  struct list *mappings = &thread_current ()->mappings;
+  struct list_elem *e;
+
+  for (e = list_begin (mappings); e != list_end (mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == id)
+        return m;
+    }
+  return NULL;
+}
+
+/* Removes mapping M and its pages, writing modified pages back
+   to the file, and frees it. */
+static void
+unmap (struct mapping *m)
+{
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove (page_lookup (m->base + i * PGSIZE));
+  list_remove (&m->elem);
+  file_close (m->file);
+  free (m);
+}
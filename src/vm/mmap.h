@@ -0,0 +1,36 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct file;
+
+/* Map region identifier. */
+typedef int mapid_t;
+#define MAP_FAILED ((mapid_t) -1)
+
+/* A file mapped into a process's address space. */
+struct mapping
+  {
+    struct list_elem elem;      /* Element in thread's `mappings'. */
+    mapid_t id;                 /* Mapping identifier. */
+    struct file *file;          /* Reference to the file mapped. */
+    uint8_t *base;              /* Start of the mapping. */
+    size_t page_cnt;            /* Number of pages mapped. */
+
+    /* Read-ahead. */
+    uint8_t *next_fault;        /* Fault address if access is sequential. */
+    size_t window;              /* Pages to read ahead at the next fault. */
+  };
+
+void mmap_table_create (void);
+void mmap_table_destroy (void);
+mapid_t mmap_map (struct file *, void *addr);
+bool mmap_unmap (mapid_t);
+void mmap_read_ahead (struct mapping *, void *upage);
+void mmap_print_stats (void);
+
+#endif /* vm/mmap.h */
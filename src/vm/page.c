@@ -0,0 +1,479 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/interrupt.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/mmap.h"
+#include "vm/share.h"
+#include "vm/swap.h"
+
+/* Cache of `struct page's. */
+static struct kmem_cache *page_cache;
+
+/* Statistics. */
+static long long file_loads;    /* Pages read in from files. */
+static long long zero_loads;    /* Pages zero-filled. */
+static long long write_backs;   /* Mapped pages written to files. */
+static long long stack_pages;   /* Pages added by stack growth. */
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_destroy;
+static void page_free (struct page *);
+
+/* Initializes the supplemental page table module. */
+void
+page_init (void)
+{
+  page_cache = kmem_cache_create ("page", sizeof (struct page), 0, NULL);
+}
+
+/* Creates the current process's supplemental page table.
+   Returns true if successful, false on allocation failure. */
+bool
+page_table_create (void)
+{
+  return hash_init (&thread_current ()->pages, page_hash, page_less, NULL);
+}
+
+/* Destroys the current process's supplemental page table,
+   freeing each resident page.  Must be called before the
+   process's page directory is destroyed. */
+void
+page_table_destroy (void)
+{
+  hash_destroy (&thread_current ()->pages, page_destroy);
+}
+
+/* Adds a page at UPAGE to the current process's page table.
+   Returns the new page, or a null pointer if UPAGE is already in
+   the table or memory is exhausted. */
+static struct page *
+page_add (void *upage, enum page_source source, bool writable)
+{
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = kmem_cache_alloc (page_cache);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->pagedir = thread_current ()->pagedir;
+  p->frame = NULL;
+  p->source = source;
+  p->writable = writable;
+  p->shareable = false;
+  p->file = NULL;
+  p->file_ofs = 0;
+  p->read_bytes = 0;
+  p->mapping = NULL;
+  p->swap_slot = SWAP_NONE;
+  if (hash_insert (&thread_current ()->pages, &p->hash_elem) != NULL)
+    {
+      kmem_cache_free (page_cache, p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Adds a page at UPAGE whose first READ_BYTES bytes are read
+   from FILE starting at offset OFS, and whose remaining bytes
+   are zeroed, when it is first accessed.  FILE must stay open
+   for as long as the page exists.  Until the process writes to
+   it, the page may share a frame with other processes that map
+   the same part of the same file.  Returns the new page, or a
+   null pointer on failure. */
+struct page *
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable)
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  if (read_bytes == 0)
+    return page_add_zero (upage, writable);
+  p = page_add (upage, PAGE_FILE, writable);
+  if (p != NULL)
+    {
+      p->file = file;
+      p->file_ofs = ofs;
+      p->read_bytes = read_bytes;
+      p->shareable = true;
+    }
+  return p;
+}
+
+/* Adds a page at UPAGE that is zeroed when it is first
+   accessed.  Returns the new page, or a null pointer on
+   failure. */
+struct page *
+page_add_zero (void *upage, bool writable)
+{
+  return page_add (upage, PAGE_ZERO, writable);
+}
+
+/* Adds a page at UPAGE to memory mapping M, holding the
+   READ_BYTES bytes of M's file at offset OFS followed by zeros.
+   The page is read when first accessed, and written back to the
+   file if modified when it is evicted or unmapped.  Returns the
+   new page, or a null pointer on failure. */
+struct page *
+page_add_mmap (void *upage, struct mapping *m, off_t ofs,
+               size_t read_bytes)
+{
+  struct page *p;
+
+  ASSERT (read_bytes > 0 && read_bytes <= PGSIZE);
+
+  p = page_add (upage, PAGE_FILE, true);
+  if (p != NULL)
+    {
+      p->file = m->file;
+      p->file_ofs = ofs;
+      p->read_bytes = read_bytes;
+      p->mapping = m;
+    }
+  return p;
+}
+
+/* Removes page P from the current process's page table and
+   frees it, writing it back first if it is a modified page of a
+   memory mapping. */
+void
+page_remove (struct page *p)
+{
+  hash_delete (&thread_current ()->pages, &p->hash_elem);
+  page_free (p);
+}
+
+/* Returns the page in the current process's page table that
+   contains UADDR, or a null pointer if there is none. */
+struct page *
+page_lookup (const void *uaddr)
+{
+  struct thread *t = thread_current ();
+  struct page p;
+  struct hash_elem *e;
+
+  if (t->pagedir == NULL || !is_user_vaddr (uaddr))
+    return NULL;
+  p.upage = pg_round_down (uaddr);
+  e = hash_find (&t->pages, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Brings page P, which must not be resident, into a frame and
+   maps it into its process's page directory.  A shareable page
+   is mapped read-only into a shared frame, unless WRITE says it
+   is about to be written, in which case it gets a private frame
+   straight away.  Returns true if successful, with P's frame
+   locked, or false on failure. */
+static bool
+page_in (struct page *p, bool write)
+{
+  struct frame *f;
+  enum intr_level old_level;
+
+  ASSERT (p->frame == NULL);
+
+  if (p->source == PAGE_FILE && p->shareable && !write
+      && share_page_in (p))
+    return true;
+
+  /* Get a frame, zeroed if nothing will be read into it. */
+  f = frame_alloc (p->source == PAGE_ZERO);
+  if (f == NULL)
+    return false;
+
+  switch (p->source)
+    {
+    case PAGE_FILE:
+      {
+        off_t bytes_read;
+
+        bytes_read = file_read_at (p->file, f->kpage, p->read_bytes,
+                                   p->file_ofs);
+        if (bytes_read != (off_t) p->read_bytes)
+          {
+            frame_free (f);
+            return false;
+          }
+      }
+      memset ((uint8_t *) f->kpage + p->read_bytes, 0,
+              PGSIZE - p->read_bytes);
+      break;
+
+    case PAGE_ZERO:
+      break;
+
+    case PAGE_SWAP:
+      swap_in (p->swap_slot, f->kpage);
+      break;
+    }
+
+  /* Until the mapping is in place, the swap slot is the only copy
+     of a swapped-out page, so it is kept until then. */
+  if (!pagedir_set_page (p->pagedir, p->upage, f->kpage, p->writable))
+    {
+      frame_free (f);
+      return false;
+    }
+  if (p->source == PAGE_SWAP)
+    {
+      swap_free (p->swap_slot);
+      p->swap_slot = SWAP_NONE;
+    }
+  list_push_back (&f->pages, &p->frame_elem);
+  p->frame = f;
+
+  old_level = intr_disable ();
+  if (p->source == PAGE_FILE)
+    file_loads++;
+  else if (p->source == PAGE_ZERO)
+    zero_loads++;
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Brings the page containing FAULT_ADDR into memory and maps it
+   into the current process's page directory.  WRITE says whether
+   the faulting access was a write.  Returns true if successful,
+   false if FAULT_ADDR is not in any page of the process or the
+   page cannot be loaded. */
+bool
+page_load (const void *fault_addr, bool write)
+{
+  struct page *p = page_lookup (fault_addr);
+
+  if (p == NULL)
+    return false;
+  frame_lock (p);
+  if (p->frame == NULL && !page_in (p, write))
+    return false;
+  frame_unlock (p->frame);
+
+  if (p->mapping != NULL)
+    mmap_read_ahead (p->mapping, p->upage);
+  return true;
+}
+
+/* Grows the current process's stack to cover FAULT_ADDR, which
+   faulted with the user stack pointer at ESP, if the access looks
+   like a push and the stack would stay within STACK_MAX bytes.
+   The new page is zeroed and mapped at once.  This goes through
+   frame_alloc(), so with a pre-zeroed page in the user pool it
+   takes only the new frame's own lock.  Returns true if
+   successful, false if the access is not a stack access or
+   memory is exhausted. */
+bool
+page_grow_stack (const void *fault_addr, const void *esp)
+{
+  uint8_t *upage = pg_round_down (fault_addr);
+  struct page *p;
+  enum intr_level old_level;
+
+  if (thread_current ()->pagedir == NULL
+      || (const uint8_t *) fault_addr + STACK_SLACK < (const uint8_t *) esp
+      || upage < (uint8_t *) PHYS_BASE - STACK_MAX)
+    return false;
+
+  p = page_add_zero (upage, true);
+  if (p == NULL)
+    return false;
+  if (!page_in (p, true))
+    {
+      page_remove (p);
+      return false;
+    }
+  frame_unlock (p->frame);
+
+  old_level = intr_disable ();
+  stack_pages++;
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Brings the page containing UADDR into memory ahead of use, if
+   it is not already there.  Returns true if the page is resident,
+   false if there is no such page or no memory for it. */
+bool
+page_prefetch (const void *uaddr)
+{
+  struct page *p = page_lookup (uaddr);
+
+  if (p == NULL)
+    return false;
+  frame_lock (p);
+  if (p->frame == NULL && !page_in (p, false))
+    return false;
+  frame_unlock (p->frame);
+  return true;
+}
+
+/* Handles a write to the present but read-only page containing
+   FAULT_ADDR.  If the page is writable but still shares its frame
+   with other processes, gives it a private copy.  Returns true
+   if the write can be retried, false if it is a genuine
+   violation or memory is exhausted. */
+bool
+page_unshare (const void *fault_addr)
+{
+  struct page *p = page_lookup (fault_addr);
+  bool success = true;
+
+  if (p == NULL || !p->writable)
+    return false;
+  frame_lock (p);
+  if (p->frame == NULL)
+    {
+      /* Evicted meanwhile.  The retried write will fault it back
+         in. */
+      return true;
+    }
+  if (p->frame->inode != NULL)
+    success = share_break (p);
+  frame_unlock (p->frame);
+  return success;
+}
+
+/* Returns true if page P was accessed since the last call, and
+   clears its accessed bit.  P's frame must be locked. */
+bool
+page_accessed_recently (struct page *p)
+{
+  bool accessed = pagedir_is_accessed (p->pagedir, p->upage);
+
+  if (accessed)
+    pagedir_set_accessed (p->pagedir, p->upage, false);
+  return accessed;
+}
+
+/* Writes page P, which must be in a frame locked by the caller,
+   back to its mapped file if it has been modified. */
+static void
+write_back (struct page *p)
+{
+  enum intr_level old_level;
+
+  ASSERT (p->mapping != NULL);
+
+  if (!pagedir_is_dirty (p->pagedir, p->upage))
+    return;
+  file_write_at (p->file, p->frame->kpage, p->read_bytes, p->file_ofs);
+
+  old_level = intr_disable ();
+  write_backs++;
+  intr_set_level (old_level);
+}
+
+/* Evicts page P from its frame, which the caller must have
+   locked.  P is unmapped first, so that its process faults
+   rather than modifying it while it is written out.  Pages of
+   memory mappings are written back to their files if modified.
+   Other clean file and zero pages are simply dropped, since they
+   can be read or zeroed again; anything else goes to swap.
+   Returns true if successful, false if swap is full. */
+bool
+page_out (struct page *p)
+{
+  struct frame *f = p->frame;
+
+  ASSERT (f != NULL && lock_held_by_current_thread (&f->lock));
+  ASSERT (f->inode == NULL);
+
+  pagedir_clear_page (p->pagedir, p->upage);
+  if (p->mapping != NULL)
+    write_back (p);
+  else if (pagedir_is_dirty (p->pagedir, p->upage)
+           || p->source == PAGE_SWAP)
+    {
+      if (!swap_out (f->kpage, &p->swap_slot))
+        {
+          /* Put the page back as it was. */
+          p->swap_slot = SWAP_NONE;
+          if (!pagedir_set_page (p->pagedir, p->upage, f->kpage,
+                                 p->writable))
+            NOT_REACHED ();
+          pagedir_set_dirty (p->pagedir, p->upage, true);
+          return false;
+        }
+      p->source = PAGE_SWAP;
+    }
+  list_remove (&p->frame_elem);
+  p->frame = NULL;
+  return true;
+}
+
+/* Prints paging statistics. */
+void
+page_print_stats (void)
+{
+  printf ("Paging: %lld pages read from files, %lld zero-filled, "
+          "%lld written back to files, %lld stack pages grown\n",
+          file_loads, zero_loads, write_backs, stack_pages);
+}
+
+/* Returns a hash value for the page that E refers to. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_int ((uintptr_t) p->upage >> PGBITS);
+}
+
+/* Returns true if the page that A refers to precedes the one
+   that B refers to. */
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+           void *aux UNUSED)
+{
+  const struct page *pa = hash_entry (a, struct page, hash_elem);
+  const struct page *pb = hash_entry (b, struct page, hash_elem);
+  return pa->upage < pb->upage;
+}
+
+/* Frees the page that E refers to. */
+static void
+page_destroy (struct hash_elem *e, void *aux UNUSED)
+{
+  page_free (hash_entry (e, struct page, hash_elem));
+}
+
+/* Unmaps and frees page P, along with its frame or swap slot,
+   writing it back first if it is a modified page of a memory
+   mapping.  Waits for any eviction of the page in progress to
+   finish first. */
+static void
+page_free (struct page *p)
+{
+  frame_lock (p);
+  if (p->frame != NULL)
+    {
+      struct frame *f = p->frame;
+
+      pagedir_clear_page (p->pagedir, p->upage);
+      if (p->mapping != NULL)
+        write_back (p);
+      if (f->inode != NULL)
+        share_detach (p);
+      else
+        {
+          list_remove (&p->frame_elem);
+          p->frame = NULL;
+          frame_free (f);
+        }
+    }
+  else if (p->source == PAGE_SWAP)
+    swap_free (p->swap_slot);
+
+  kmem_cache_free (page_cache, p);
+}
@@ -0,0 +1,79 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+/* Stack growth.  A fault at most STACK_SLACK bytes below the
+   user stack pointer (PUSHA pushes 32 bytes before it adjusts
+   %esp) grows the stack, as long as it stays within STACK_MAX
+   bytes of PHYS_BASE. */
+#define STACK_SLACK 32
+#define STACK_MAX (8 * 1024 * 1024)
+
+/* Where a page's contents come from when it is not resident. */
+enum page_source
+  {
+    PAGE_FILE,                  /* Read from a file. */
+    PAGE_ZERO,                  /* All zeros. */
+    PAGE_SWAP                   /* Swap slot, once it has been dirtied. */
+  };
+
+/* A page of user virtual memory, as recorded in the owning
+   process's supplemental page table.  The page is brought into
+   memory the first time it is touched, and again whenever it is
+   touched after being evicted.
+
+   A page whose frame is locked (see vm/frame.h) stays resident;
+   FRAME changes only while its lock is held.  An unmodified page
+   of an executable may share its frame with the same page in
+   other processes (see vm/share.c). */
+struct page
+  {
+    struct hash_elem hash_elem; /* Element in thread's `pages'. */
+    void *upage;                /* User virtual address. */
+    uint32_t *pagedir;          /* Owning process's page directory. */
+    struct frame *frame;        /* Frame holding the page, or null. */
+    struct list_elem frame_elem; /* Element in frame's `pages'. */
+    enum page_source source;    /* Where to get the contents. */
+    bool writable;              /* Writable by the user process? */
+    bool shareable;             /* May share a frame until written? */
+
+    /* For PAGE_FILE pages. */
+    struct file *file;          /* File to read. */
+    off_t file_ofs;             /* Offset in FILE. */
+    size_t read_bytes;          /* Bytes to read; the rest are zeroed. */
+    struct mapping *mapping;    /* Memory mapping, whose pages are
+                                   written back to FILE, or null. */
+
+    /* For PAGE_SWAP pages. */
+    size_t swap_slot;           /* Slot holding the page, or SWAP_NONE
+                                   while the page is resident. */
+  };
+
+void page_init (void);
+bool page_table_create (void);
+void page_table_destroy (void);
+
+struct page *page_add_file (void *upage, struct file *, off_t ofs,
+                            size_t read_bytes, bool writable);
+struct page *page_add_zero (void *upage, bool writable);
+struct page *page_add_mmap (void *upage, struct mapping *, off_t ofs,
+                            size_t read_bytes);
+void page_remove (struct page *);
+struct page *page_lookup (const void *uaddr);
+bool page_load (const void *fault_addr, bool write);
+bool page_unshare (const void *fault_addr);
+bool page_grow_stack (const void *fault_addr, const void *esp);
+bool page_prefetch (const void *uaddr);
+
+/* For use by the frame table. */
+bool page_accessed_recently (struct page *);
+bool page_out (struct page *);
+
+void page_print_stats (void);
+
+#endif /* vm/page.h */
@@ -0,0 +1,304 @@
+#include "vm/share.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* Frames shared among processes.
+
+   A page read from an executable is first mapped read-only into
+   a frame that any other process wanting the same bytes of the
+   same inode also maps, so that running a program many times
+   reads and stores its text only once.  Such a frame is found
+   through SHARED, keyed by inode, offset, and length.  A writable
+   page stays in the shared frame until its process writes to
+   it, at which point share_break() gives it a private copy.
+
+   Lock order: a frame's lock, then SHARE_LOCK.  Code that holds
+   SHARE_LOCK only ever tries to lock a frame that might be in
+   use, and backs off if it cannot. */
+static struct hash shared;
+static struct lock share_lock;
+
+/* Statistics. */
+static long long share_reads;   /* Pages read into new shared frames. */
+static long long share_hits;    /* Pages mapped to an existing frame. */
+static long long cow_copies;    /* Pages copied on write. */
+static long long cow_takeovers; /* Written pages that were not copied. */
+
+static hash_hash_func share_hash;
+static hash_less_func share_less;
+static bool map (struct page *, struct frame *);
+
+/* Initializes the shared frame table. */
+void
+share_init (void)
+{
+  if (!hash_init (&shared, share_hash, share_less, NULL))
+    PANIC ("share: could not allocate shared frame table");
+  lock_init (&share_lock);
+}
+
+/* Maps page P, a page of a file that P->frame does not hold,
+   read-only to a frame holding the same file data, reading it
+   into a new frame if no process has it in memory.  Returns true
+   if successful, with P's frame locked, or false on failure. */
+bool
+share_page_in (struct page *p)
+{
+  struct frame key;
+  struct frame *f;
+  struct frame *spare = NULL;
+  off_t bytes_read;
+
+  ASSERT (p->frame == NULL);
+
+  key.inode = file_get_inode (p->file);
+  key.ofs = p->file_ofs;
+  key.read_bytes = p->read_bytes;
+  for (;;)
+    {
+      struct hash_elem *e;
+
+      lock_acquire (&share_lock);
+      e = hash_find (&shared, &key.share_elem);
+      if (e == NULL)
+        {
+          if (spare != NULL)
+            break;
+
+          /* Allocating a frame may have to evict, and so write to
+             disk, and it locks the frame, so do it without holding
+             SHARE_LOCK.  Then look again, since someone else may
+             have read the data in the meantime. */
+          lock_release (&share_lock);
+          spare = frame_alloc (false);
+          if (spare == NULL)
+            return false;
+          continue;
+        }
+
+      f = hash_entry (e, struct frame, share_elem);
+      if (lock_held_by_current_thread (&f->lock))
+        {
+          /* Locked by us for another page.  Unusual enough that
+             we just give P a private copy. */
+          lock_release (&share_lock);
+          if (spare != NULL)
+            frame_free (spare);
+          return false;
+        }
+      if (lock_try_acquire (&f->lock))
+        {
+          list_push_back (&f->pages, &p->frame_elem);
+          p->frame = f;
+          share_hits++;
+          lock_release (&share_lock);
+          if (spare != NULL)
+            frame_free (spare);
+          return map (p, f);
+        }
+
+      /* The frame is busy.  Wait for it without holding
+         SHARE_LOCK, or a spare frame's lock, then look again,
+         since it may have been evicted in the meantime. */
+      lock_release (&share_lock);
+      if (spare != NULL)
+        {
+          frame_free (spare);
+          spare = NULL;
+        }
+      lock_acquire (&f->lock);
+      lock_release (&f->lock);
+    }
+
+  /* Nobody has the data.  Publish the spare frame, then read into
+     it with SHARE_LOCK released; anyone else who wants it will
+     wait on the frame's lock. */
+  f = spare;
+  f->inode = key.inode;
+  f->ofs = key.ofs;
+  f->read_bytes = key.read_bytes;
+  hash_insert (&shared, &f->share_elem);
+  list_push_back (&f->pages, &p->frame_elem);
+  p->frame = f;
+  share_reads++;
+  lock_release (&share_lock);
+
+  bytes_read = file_read_at (p->file, f->kpage, p->read_bytes, p->file_ofs);
+  if (bytes_read != (off_t) p->read_bytes)
+    {
+      share_detach (p);
+      return false;
+    }
+  memset ((uint8_t *) f->kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+  return map (p, f);
+}
+
+/* Maps page P read-only to frame F, which P has just been added
+   to.  On failure, removes P from F. */
+static bool
+map (struct page *p, struct frame *f)
+{
+  if (!pagedir_set_page (p->pagedir, p->upage, f->kpage, false))
+    {
+      share_detach (p);
+      return false;
+    }
+  return true;
+}
+
+/* Gives writable page P, whose shared frame the caller has
+   locked, a private frame of its own, and maps it writable.  If P
+   is the only page in the frame, the frame itself becomes
+   private; otherwise P gets a copy.  Returns true if successful,
+   with P's new frame locked, or false if out of memory. */
+bool
+share_break (struct page *p)
+{
+  struct frame *f = p->frame;
+  struct frame *copy;
+
+  ASSERT (f != NULL && f->inode != NULL);
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (p->writable);
+
+  pagedir_clear_page (p->pagedir, p->upage);
+  if (list_front (&f->pages) == list_back (&f->pages))
+    {
+      lock_acquire (&share_lock);
+      hash_delete (&shared, &f->share_elem);
+      f->inode = NULL;
+      cow_takeovers++;
+      lock_release (&share_lock);
+      copy = f;
+    }
+  else
+    {
+      copy = frame_alloc (false);
+      if (copy == NULL)
+        {
+          if (!pagedir_set_page (p->pagedir, p->upage, f->kpage, false))
+            NOT_REACHED ();
+          return false;
+        }
+      memcpy (copy->kpage, f->kpage, PGSIZE);
+      share_detach (p);
+      list_push_back (&copy->pages, &p->frame_elem);
+      p->frame = copy;
+
+      lock_acquire (&share_lock);
+      cow_copies++;
+      lock_release (&share_lock);
+    }
+
+  /* The page no longer matches the file, so if it is evicted it
+     must go to swap. */
+  p->source = PAGE_SWAP;
+  p->swap_slot = SWAP_NONE;
+  if (!pagedir_set_page (p->pagedir, p->upage, copy->kpage, true))
+    NOT_REACHED ();
+  return true;
+}
+
+/* Removes page P from its shared frame, which the caller must
+   have locked, and unlocks the frame.  If P was the frame's last
+   page, frees the frame.  Does not touch P's mapping. */
+void
+share_detach (struct page *p)
+{
+  struct frame *f = p->frame;
+  bool last;
+
+  ASSERT (f != NULL && f->inode != NULL);
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  lock_acquire (&share_lock);
+  list_remove (&p->frame_elem);
+  p->frame = NULL;
+  last = list_empty (&f->pages);
+  if (last)
+    {
+      hash_delete (&shared, &f->share_elem);
+      f->inode = NULL;
+    }
+  lock_release (&share_lock);
+
+  if (last)
+    frame_free (f);
+  else
+    frame_unlock (f);
+}
+
+/* Evicts shared frame F, which the caller must have locked, by
+   unmapping it from every process.  Its pages are clean copies
+   of file data, so nothing needs to be written.  Returns true if
+   successful, false if the shared frame table is busy. */
+bool
+share_evict (struct frame *f)
+{
+  bool held = lock_held_by_current_thread (&share_lock);
+
+  ASSERT (f->inode != NULL);
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  if (!held && !lock_try_acquire (&share_lock))
+    return false;
+  hash_delete (&shared, &f->share_elem);
+  f->inode = NULL;
+  while (!list_empty (&f->pages))
+    {
+      struct page *p = list_entry (list_pop_front (&f->pages),
+                                   struct page, frame_elem);
+      pagedir_clear_page (p->pagedir, p->upage);
+      p->frame = NULL;
+    }
+  if (!held)
+    lock_release (&share_lock);
+  return true;
+}
+
+/* Prints sharing statistics. */
+void
+share_print_stats (void)
+{
+  printf ("Sharing: %lld pages read, %lld shared mappings, "
+          "%lld copies on write, %lld writes without a copy\n",
+          share_reads, share_hits, cow_copies, cow_takeovers);
+}
+
+/* Returns a hash value for the shared frame that E refers to. */
+static unsigned
+share_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, share_elem);
+  unsigned key[3];
+
+  key[0] = (uintptr_t) f->inode;
+  key[1] = f->ofs;
+  key[2] = f->read_bytes;
+  return hash_bytes (key, sizeof key);
+}
+
+/* Returns true if shared frame A precedes shared frame B. */
+static bool
+share_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, share_elem);
+  const struct frame *b = hash_entry (b_, struct frame, share_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  else if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  else
+    return a->read_bytes < b->read_bytes;
+}
@@ -0,0 +1,16 @@
+#ifndef VM_SHARE_H
+#define VM_SHARE_H
+
+#include <stdbool.h>
+
+struct frame;
+struct page;
+
+void share_init (void);
+bool share_page_in (struct page *);
+bool share_break (struct page *);
+void share_detach (struct page *);
+bool share_evict (struct frame *);
+void share_print_stats (void);
+
+#endif /* vm/share.h */
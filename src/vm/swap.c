@@ -0,0 +1,107 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Number of sectors in a page-sized swap slot. */
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* The swap device, or a null pointer if there is none. */
+static struct block *swap_device;
+
+/* Slots in use: one bit per page-sized slot on SWAP_DEVICE. */
+static struct bitmap *swap_map;
+static struct lock swap_lock;   /* Protects SWAP_MAP and counters. */
+
+/* Statistics. */
+static long long swap_writes;   /* Pages written to swap. */
+static long long swap_reads;    /* Pages read back from swap. */
+static size_t used_cnt;         /* Slots in use right now. */
+static size_t used_peak;        /* Most slots ever in use at once. */
+
+/* Sets up swap on the block device with role BLOCK_SWAP, if
+   there is one.  Without a swap device, every swap_out() fails,
+   so only clean pages can be evicted. */
+void
+swap_init (void)
+{
+  size_t slot_cnt = 0;
+
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device != NULL)
+    slot_cnt = block_size (swap_device) / SECTORS_PER_SLOT;
+  else
+    printf ("swap: no swap device, swapping disabled\n");
+  swap_map = bitmap_create (slot_cnt);
+  if (swap_map == NULL)
+    PANIC ("swap: could not allocate slot bitmap");
+  lock_init (&swap_lock);
+}
+
+/* Writes the page at KPAGE to a free swap slot and stores the
+   slot's number in *SLOT.  Returns true if successful, false if
+   swap is full. */
+bool
+swap_out (const void *kpage, size_t *slot)
+{
+  size_t i;
+
+  lock_acquire (&swap_lock);
+  *slot = bitmap_scan_and_flip (swap_map, 0, 1, false);
+  if (*slot != BITMAP_ERROR)
+    {
+      swap_writes++;
+      if (++used_cnt > used_peak)
+        used_peak = used_cnt;
+    }
+  lock_release (&swap_lock);
+  if (*slot == BITMAP_ERROR)
+    return false;
+
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    block_write (swap_device, *slot * SECTORS_PER_SLOT + i,
+                 (const uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+  return true;
+}
+
+/* Reads swap slot SLOT into the page at KPAGE.  The slot stays
+   allocated until the caller frees it with swap_free(), once the
+   page's contents are safe elsewhere. */
+void
+swap_in (size_t slot, void *kpage)
+{
+  size_t i;
+
+  ASSERT (bitmap_test (swap_map, slot));
+
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    block_read (swap_device, slot * SECTORS_PER_SLOT + i,
+                (uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&swap_lock);
+  swap_reads++;
+  lock_release (&swap_lock);
+}
+
+/* Frees swap slot SLOT without reading it. */
+void
+swap_free (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_map, slot));
+  bitmap_reset (swap_map, slot);
+  used_cnt--;
+  lock_release (&swap_lock);
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  printf ("Swap: %lld pages written, %lld pages read, "
+          "%zu of %zu slots in use at peak\n",
+          swap_writes, swap_reads, used_peak, bitmap_size (swap_map));
+}